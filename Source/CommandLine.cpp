@@ -170,6 +170,61 @@ namespace
         return juce::jmax (1, (int) getOptionValue (args, "--repeat", 1, "Missing repeat argument! (Must be greater than 0)"));
     }
 
+    int getMessageThreadStallThreshold (const juce::ArgumentList& args)
+    {
+        return juce::jmax (0, (int) getOptionValue (args, "--message-thread-stall-ms", 0, "Missing message-thread-stall-ms argument!"));
+    }
+
+    int getChainLength (const juce::ArgumentList& args)
+    {
+        return juce::jmax (0, (int) getOptionValue (args, "--chain-length", 0, "Missing chain-length argument!"));
+    }
+
+    int getCacheEvictionSize (const juce::ArgumentList& args)
+    {
+        return juce::jmax (0, (int) getOptionValue (args, "--cache-evict-kb", 0, "Missing cache-evict-kb argument!"));
+    }
+
+    int getStressThreads (const juce::ArgumentList& args)
+    {
+        return juce::jmax (0, (int) getOptionValue (args, "--stress-threads", 0, "Missing stress-threads argument!"));
+    }
+
+    int getStressIntensity (const juce::ArgumentList& args)
+    {
+        return juce::jlimit (1, 100, (int) getOptionValue (args, "--stress-intensity", 100, "Missing stress-intensity argument! (Must be between 1 - 100)"));
+    }
+
+    int getMinimumBufferSeconds (const juce::ArgumentList& args)
+    {
+        return juce::jmax (1, (int) getOptionValue (args, "--min-buffer-seconds", 2, "Missing min-buffer-seconds argument! (Must be greater than 0)"));
+    }
+
+    juce::StringArray getChainPlugins (const juce::ArgumentList& args)
+    {
+        auto plugins = juce::StringArray::fromTokens (getOptionValue (args, "--chain-plugins", {}, "Missing chain-plugins list argument!").toString(),
+                                                      ",", "\"");
+        plugins.trim();
+        plugins.removeEmptyStrings();
+
+        // As with --validate, resolve relative paths but leave IDs alone
+        for (auto& fileOrID : plugins)
+            if (fileOrID.contains ("~") || fileOrID.contains ("."))
+                fileOrID = juce::File::getCurrentWorkingDirectory().getChildFile (fileOrID).getFullPathName();
+
+        return plugins;
+    }
+
+    int getRealtimePriority (const juce::ArgumentList& args)
+    {
+        return juce::jlimit (1, 99, (int) getOptionValue (args, "--realtime-priority", 80, "Missing realtime-priority argument! (Must be between 1 - 99)"));
+    }
+
+    int getRealtimeCpuCore (const juce::ArgumentList& args)
+    {
+        return juce::jmax (-1, (int) getOptionValue (args, "--realtime-cpu", -1, "Missing realtime-cpu argument!"));
+    }
+
     juce::File getDataFile (const juce::ArgumentList& args)
     {
         return getOptionValue (args, "--data-file", {}, "Missing data-file path argument!").toString();
@@ -285,6 +340,18 @@ static Option possibleOptions[] =
     { "--sample-rates",         true    },
     { "--block-sizes",          true    },
     { "--vst3validator",        true    },
+    { "--lock-memory",          false   },
+    { "--realtime-thread",      false   },
+    { "--realtime-priority",    true    },
+    { "--realtime-cpu",         true    },
+    { "--perf-counters",        false   },
+    { "--message-thread-stall-ms", true },
+    { "--chain-length",         true    },
+    { "--chain-plugins",        true    },
+    { "--cache-evict-kb",       true    },
+    { "--stress-threads",       true    },
+    { "--stress-intensity",     true    },
+    { "--min-buffer-seconds",   true    },
 };
 
 static juce::StringArray mergeEnvironmentVariables (juce::StringArray args, std::function<juce::String (const juce::String& name, const juce::String& defaultValue)> environmentVariableProvider = [] (const juce::String& name, const juce::String& defaultValue) { return juce::SystemStats::getEnvironmentVariable (name, defaultValue); })
@@ -362,6 +429,48 @@ static juce::String getHelpMessage()
          << "    Sets a timout which will stop validation with an error if no output from any" << newLine
          << "    test has happened for this number of ms." << newLine
          << "    By default this is 30s but can be set to \"-1\" (must be quoted) to never timeout." << newLine
+         << "  --lock-memory" << newLine
+         << "    If specified, locks all process memory in to RAM (using mlockall) before" << newLine
+         << "    running the tests to emulate hosts that do this. Page faults during" << newLine
+         << "    processing are still reported." << newLine
+         << "  --realtime-thread" << newLine
+         << "    If specified, runs the audio processing tests on a dedicated real-time" << newLine
+         << "    (SCHED_FIFO) thread, as hosts do. If this isn't permitted, the highest" << newLine
+         << "    normal priority is used instead and this is noted in the log." << newLine
+         << "  --realtime-priority [1-99]" << newLine
+         << "    Sets the SCHED_FIFO priority of the real-time thread (default=80)." << newLine
+         << "  --realtime-cpu [coreIndex]" << newLine
+         << "    If specified, pins the real-time thread to the given CPU core." << newLine
+         << "  --perf-counters" << newLine
+         << "    If specified, reads hardware performance counters (cycles, instructions," << newLine
+         << "    cache and branch misses) around each processBlock call and reports the" << newLine
+         << "    cycles per sample per channel and IPC. Currently only supported on Linux." << newLine
+         << "  --message-thread-stall-ms [numMilliseconds]" << newLine
+         << "    The message thread is monitored during every test and the worst stall is" << newLine
+         << "    logged. If specified, tests that block it for longer than this will fail." << newLine
+         << "  --chain-length [numInstances]" << newLine
+         << "    If specified, benchmarks a chain of this many plugin instances run in series" << newLine
+         << "    in an AudioProcessorGraph and reports how much slower each instance runs in" << newLine
+         << "    the chain than on its own. Runs at strictness level 8 and above." << newLine
+         << "  --chain-plugins [list of comma separated paths or IDs]" << newLine
+         << "    If specified, these plugins are interleaved with the one being tested in" << newLine
+         << "    the chain. Otherwise the chain is made from instances of the tested plugin." << newLine
+         << "  --cache-evict-kb [numKilobytes]" << newLine
+         << "    If specified, benchmarks processBlock with cold caches by writing to a buffer" << newLine
+         << "    of this size before each call, as other plugins in a busy session would," << newLine
+         << "    and compares it with warm caches. Use a size larger than the CPU's last" << newLine
+         << "    level cache, e.g. 65536. Runs at strictness level 7 and above." << newLine
+         << "  --stress-threads [numThreads]" << newLine
+         << "    If specified, benchmarks processBlock whilst this many background threads" << newLine
+         << "    generate CPU, memory bandwidth and lock contention load in turn, and reports" << newLine
+         << "    how the timings degrade compared to an unloaded run. Runs at strictness" << newLine
+         << "    level 7 and above." << newLine
+         << "  --stress-intensity [1-100]" << newLine
+         << "    The percentage of the time the stressor threads are busy for (default=100)." << newLine
+         << "  --min-buffer-seconds [numSeconds]" << newLine
+         << "    How many seconds of simulated audio callbacks the minimum buffer size" << newLine
+         << "    benchmark runs at each block size it tries (default=2). Longer runs are more" << newLine
+         << "    likely to catch occasional spikes." << newLine
          << newLine
          // repeating tests
          << "  --repeat [num repeats]" << newLine
@@ -552,6 +661,18 @@ std::pair<juce::String, PluginTests::Options> parseCommandLine (const juce::Argu
     options.sampleRates         = getSampleRates (args);
     options.blockSizes          = getBlockSizes (args);
     options.vst3Validator       = getOptionValue (args, "--vst3validator", "", "Expected a path for the --vst3validator option");
+    options.lockMemory          = args.containsOption ("--lock-memory");
+    options.realtimeThread      = args.containsOption ("--realtime-thread");
+    options.realtimePriority    = getRealtimePriority (args);
+    options.realtimeCpuCore     = getRealtimeCpuCore (args);
+    options.performanceCounters = args.containsOption ("--perf-counters");
+    options.messageThreadStallThresholdMs = getMessageThreadStallThreshold (args);
+    options.chainLength         = getChainLength (args);
+    options.chainPlugins        = getChainPlugins (args);
+    options.cacheEvictionSizeKb = getCacheEvictionSize (args);
+    options.stressThreads       = getStressThreads (args);
+    options.stressIntensity     = getStressIntensity (args);
+    options.minimumBufferSeconds = getMinimumBufferSeconds (args);
 
     return { fileOrID, options };
 }
@@ -622,6 +743,42 @@ juce::StringArray createCommandLine (juce::String fileOrID, PluginTests::Options
     if (options.vst3Validator != juce::File())
         args.addArray ({ "--vst3validator", options.vst3Validator.getFullPathName().quoted() });
 
+    if (options.lockMemory)
+        args.add ("--lock-memory");
+
+    if (options.realtimeThread)
+        args.add ("--realtime-thread");
+
+    if (options.realtimePriority != defaults.realtimePriority)
+        args.addArray ({ "--realtime-priority", juce::String (options.realtimePriority) });
+
+    if (options.realtimeCpuCore != defaults.realtimeCpuCore)
+        args.addArray ({ "--realtime-cpu", juce::String (options.realtimeCpuCore) });
+
+    if (options.performanceCounters)
+        args.add ("--perf-counters");
+
+    if (options.messageThreadStallThresholdMs != defaults.messageThreadStallThresholdMs)
+        args.addArray ({ "--message-thread-stall-ms", juce::String (options.messageThreadStallThresholdMs) });
+
+    if (options.chainLength != defaults.chainLength)
+        args.addArray ({ "--chain-length", juce::String (options.chainLength) });
+
+    if (! options.chainPlugins.isEmpty())
+        args.addArray ({ "--chain-plugins", options.chainPlugins.joinIntoString (",") });
+
+    if (options.cacheEvictionSizeKb != defaults.cacheEvictionSizeKb)
+        args.addArray ({ "--cache-evict-kb", juce::String (options.cacheEvictionSizeKb) });
+
+    if (options.stressThreads != defaults.stressThreads)
+        args.addArray ({ "--stress-threads", juce::String (options.stressThreads) });
+
+    if (options.stressIntensity != defaults.stressIntensity)
+        args.addArray ({ "--stress-intensity", juce::String (options.stressIntensity) });
+
+    if (options.minimumBufferSeconds != defaults.minimumBufferSeconds)
+        args.addArray ({ "--min-buffer-seconds", juce::String (options.minimumBufferSeconds) });
+
     args.addArray ({ "--validate", fileOrID });
 
     return args;
@@ -154,6 +154,67 @@ struct CommandLineTests : public juce::UnitTest
             expect (shouldPerformCommandLine (temp.getFile().getFullPathName()));
         }
 
+        beginTest ("Processing options");
+        {
+            const auto args = createCommandLineArgs ("--lock-memory --perf-counters --validate MyPlugin.vst3");
+            const auto options = parseCommandLine (args).second;
+            expect (options.lockMemory);
+            expect (options.performanceCounters);
+            expect (createCommandLine ("MyPlugin.vst3", options).contains ("--lock-memory"));
+            expect (createCommandLine ("MyPlugin.vst3", options).contains ("--perf-counters"));
+
+            const auto defaults = parseCommandLine (createCommandLineArgs ("--validate MyPlugin.vst3")).second;
+            expect (! defaults.lockMemory);
+            expect (! defaults.performanceCounters);
+            expectEquals (defaults.messageThreadStallThresholdMs, 0);
+
+            const auto stallOptions = parseCommandLine (createCommandLineArgs ("--message-thread-stall-ms 250 --validate MyPlugin.vst3")).second;
+            expectEquals (stallOptions.messageThreadStallThresholdMs, 250);
+            expect (createCommandLine ("MyPlugin.vst3", stallOptions).joinIntoString (" ").contains ("--message-thread-stall-ms 250"));
+
+            expectEquals (defaults.chainLength, 0);
+            expect (defaults.chainPlugins.isEmpty());
+
+            const auto currentDir = juce::File::getCurrentWorkingDirectory();
+            const auto chainOptions = parseCommandLine (createCommandLineArgs ("--chain-length 4 --chain-plugins Other.vst3,VST3-Other-1a2b3c4d-5e6f7a8b --validate MyPlugin.vst3")).second;
+            expectEquals (chainOptions.chainLength, 4);
+            expectEquals (chainOptions.chainPlugins.size(), 2);
+            expectEquals (chainOptions.chainPlugins[0], currentDir.getChildFile ("Other.vst3").getFullPathName());
+            expectEquals (chainOptions.chainPlugins[1], juce::String ("VST3-Other-1a2b3c4d-5e6f7a8b"));
+            expect (createCommandLine ("MyPlugin.vst3", chainOptions).joinIntoString (" ").contains ("--chain-length 4"));
+
+            expectEquals (defaults.cacheEvictionSizeKb, 0);
+            const auto cacheOptions = parseCommandLine (createCommandLineArgs ("--cache-evict-kb 32768 --validate MyPlugin.vst3")).second;
+            expectEquals (cacheOptions.cacheEvictionSizeKb, 32768);
+            expect (createCommandLine ("MyPlugin.vst3", cacheOptions).joinIntoString (" ").contains ("--cache-evict-kb 32768"));
+
+            expectEquals (defaults.stressThreads, 0);
+            expectEquals (defaults.stressIntensity, 100);
+            const auto stressOptions = parseCommandLine (createCommandLineArgs ("--stress-threads 8 --stress-intensity 50 --validate MyPlugin.vst3")).second;
+            expectEquals (stressOptions.stressThreads, 8);
+            expectEquals (stressOptions.stressIntensity, 50);
+            expect (createCommandLine ("MyPlugin.vst3", stressOptions).joinIntoString (" ").contains ("--stress-intensity 50"));
+
+            expectEquals (defaults.minimumBufferSeconds, 2);
+            const auto bufferOptions = parseCommandLine (createCommandLineArgs ("--min-buffer-seconds 10 --validate MyPlugin.vst3")).second;
+            expectEquals (bufferOptions.minimumBufferSeconds, 10);
+            expect (createCommandLine ("MyPlugin.vst3", bufferOptions).joinIntoString (" ").contains ("--min-buffer-seconds 10"));
+        }
+
+        beginTest ("Real-time thread options");
+        {
+            const auto defaults = parseCommandLine (createCommandLineArgs ("--validate MyPlugin.vst3")).second;
+            expect (! defaults.realtimeThread);
+            expectEquals (defaults.realtimePriority, 80);
+            expectEquals (defaults.realtimeCpuCore, -1);
+
+            const auto options = parseCommandLine (createCommandLineArgs ("--realtime-thread --realtime-priority 70 --realtime-cpu 2 --validate MyPlugin.vst3")).second;
+            expect (options.realtimeThread);
+            expectEquals (options.realtimePriority, 70);
+            expectEquals (options.realtimeCpuCore, 2);
+            expect (createCommandLine ("MyPlugin.vst3", options).joinIntoString (" ").contains ("--realtime-priority 70"));
+        }
+
         beginTest ("Allows for other options after explicit --validate");
         {
             const auto currentDir = juce::File::getCurrentWorkingDirectory();
@@ -43,12 +43,31 @@ namespace
         (new AsyncDeleter (std::move (pluginInstance), completionEvent))->post();
         completionEvent.wait();
     }
+
+    /** Logs how long the message thread was blocked for during a test, failing
+        if this is over the threshold set in the options.
+    */
+    void checkMessageThreadStalls (PluginTests& ut, const MessageThreadWatchdog::Results& results)
+    {
+        ut.logVerboseMessage (results.getDescription());
+
+        const auto worstStallMs = juce::roundToInt (results.worstStallMs);
+        const auto thresholdMs = ut.getOptions().messageThreadStallThresholdMs;
+
+        if (thresholdMs > 0)
+            ut.expect (worstStallMs <= thresholdMs,
+                       "Message thread blocked for " + juce::String (worstStallMs) + " ms, more than the threshold of "
+                       + juce::String (thresholdMs) + " ms");
+        else if (worstStallMs >= 500)
+            ut.logMessage ("!!! WARNING: Message thread blocked for " + juce::String (worstStallMs) + " ms");
+    }
 }
 
 PluginTests::PluginTests (const juce::String& fileOrIdentifier, Options opts)
     : juce::UnitTest ("pluginval"),
       fileOrID (fileOrIdentifier),
-      options (opts)
+      options (opts),
+      bufferPool (std::make_unique<ProcessingBufferPool>())
 {
     jassert (fileOrIdentifier.isNotEmpty());
     jassert (juce::isPositiveAndNotGreaterThan (options.strictnessLevel, 10));
@@ -61,6 +80,8 @@ PluginTests::PluginTests (const juce::PluginDescription& desc, Options opts)
     typesFound.add (new juce::PluginDescription (desc));
 }
 
+PluginTests::~PluginTests() = default;
+
 juce::String PluginTests::getFileOrID() const
 {
     if (fileOrID.isNotEmpty())
@@ -83,6 +104,41 @@ void PluginTests::resetTimeout()
     logMessage (juce::String());
 }
 
+ProcessingBufferPool& PluginTests::getBufferPool()
+{
+    return *bufferPool;
+}
+
+std::unique_ptr<juce::AudioPluginInstance> PluginTests::createPluginInstance (const juce::PluginDescription& pd,
+                                                                          double sampleRate, int blockSize,
+                                                                          juce::String& errorMessage)
+{
+    return std::unique_ptr<juce::AudioPluginInstance> (formatManager.createPluginInstance (pd, sampleRate, blockSize, errorMessage));
+}
+
+juce::OwnedArray<juce::PluginDescription> PluginTests::findPluginDescriptions (const juce::String& fileOrIdentifier)
+{
+    juce::OwnedArray<juce::PluginDescription> descriptions;
+
+    juce::WaitableEvent completionEvent;
+    juce::MessageManager::callAsync ([&, this]() mutable
+                               {
+                                   knownPluginList.scanAndAddDragAndDroppedFiles (formatManager, juce::StringArray (fileOrIdentifier), descriptions);
+                                   completionEvent.signal();
+                               });
+    completionEvent.wait();
+
+    return descriptions;
+}
+
+void PluginTests::callOnAudioThread (const std::function<void()>& function)
+{
+    if (audioThread != nullptr)
+        audioThread->call (function);
+    else
+        function();
+}
+
 void PluginTests::runTest()
 {
     // This has to be called on a background thread to keep the message thread free
@@ -92,6 +148,19 @@ void PluginTests::runTest()
     logVerboseMessage ("\t" + juce::Time::getCurrentTime().toString (true, true) + "\n");
     logMessage ("Strictness level: " + juce::String (options.strictnessLevel));
 
+    // Allocation violations are queued by the offending thread and logged from here
+    const AllocationViolationLogger allocationViolationLogger;
+
+    if (options.lockMemory)
+    {
+        const auto lockResult = lockProcessMemory();
+
+        if (lockResult.wasOk())
+            logMessage ("Process memory locked");
+        else
+            logMessage ("!!! WARNING: Unable to lock process memory: " + lockResult.getErrorMessage());
+    }
+
     if (fileOrID.isNotEmpty())
     {
         beginTest ("Scan for plugins located in: " + fileOrID);
@@ -117,12 +186,15 @@ void PluginTests::runTest()
 
     for (auto pd : typesFound)
         testType (*pd);
+
+    if (options.lockMemory)
+        unlockProcessMemory();
 }
 
 std::unique_ptr<juce::AudioPluginInstance> PluginTests::testOpenPlugin (const juce::PluginDescription& pd)
 {
     juce::String errorMessage;
-    auto instance = std::unique_ptr<juce::AudioPluginInstance> (formatManager.createPluginInstance (pd, 44100.0, 512, errorMessage));
+    auto instance = createPluginInstance (pd, 44100.0, 512, errorMessage);
     expectEquals (errorMessage, juce::String());
     expect (instance != nullptr, "Unable to create juce::AudioPluginInstance");
 
@@ -161,6 +233,27 @@ void PluginTests::testType (const juce::PluginDescription& pd)
             juce::Thread::sleep (150);
             auto r = getRandom();
 
+            // Some tests process blocks twice the size they prepared with
+            int maxBlockSize = instance->getBlockSize();
+
+            for (auto bs : options.blockSizes)
+                maxBlockSize = juce::jmax (maxBlockSize, bs);
+
+            bufferPool->reserve (juce::jmax (instance->getTotalNumInputChannels(), instance->getTotalNumOutputChannels()),
+                                 maxBlockSize * 2);
+
+            if (options.realtimeThread)
+            {
+                audioThread = std::make_unique<RealtimeThread> (options.realtimePriority, options.realtimeCpuCore);
+                logMessage ("Audio processing tests running on a real-time thread: " + audioThread->getDescription());
+            }
+            else
+            {
+                logMessage ("Audio processing tests running on the test thread");
+            }
+
+            MessageThreadWatchdog messageThreadWatchdog;
+
             for (int testRun = 0; testRun < options.numRepeats; ++testRun)
             {
                 if (options.numRepeats > 1)
@@ -186,8 +279,14 @@ void PluginTests::testType (const juce::PluginDescription& pd)
                         continue;
                     }
 
+                    // Rebuilt before each test as a previous test may have caused the
+                    // plugin to recreate its parameters, leaving dangling pointers
+                    automatableParameters = getNonBypassAutomatableParameters (*instance);
+
                     StopwatchTimer sw2;
                     beginTest (t->name);
+                    AllocationViolationLog::getInstance().setCurrentTest (t->name);
+                    messageThreadWatchdog.reset();
 
                     if (t->needsToRunOnMessageThread())
                     {
@@ -199,15 +298,38 @@ void PluginTests::testType (const juce::PluginDescription& pd)
                                                    });
                         completionEvent.wait();
                     }
+                    else if (t->needsToRunOnAudioThread() && audioThread != nullptr)
+                    {
+                        audioThread->call ([&, this] { t->runTest (*this, *instance); });
+                    }
                     else
                     {
                         t->runTest (*this, *instance);
                     }
 
                     logVerboseMessage ("\nTime taken to run test: " + sw2.getDescription());
+
+                    if (t->needsToRunOnMessageThread())
+                    {
+                        // These tests hold the message thread for their whole run, so the heartbeat waiting
+                        // for them to return isn't counted. Any let through whilst they run the message loop,
+                        // e.g. after opening an editor, show how long the plugin blocked it before that.
+                        const auto results = messageThreadWatchdog.getResults (false);
+
+                        if (results.numHeartbeats > 0)
+                            checkMessageThreadStalls (*this, results);
+                        else
+                            logMessage ("INFO: Message thread stalls not checked as the test didn't run the message loop");
+                    }
+                    else
+                    {
+                        checkMessageThreadStalls (*this, messageThreadWatchdog.getResults());
+                    }
                 }
             }
 
+            automatableParameters.clear();
+            audioThread.reset();
             deletePluginAsync (std::move (instance));
         }
     }
@@ -16,6 +16,9 @@
 
 #include "juce_audio_processors/juce_audio_processors.h"
 
+class ProcessingBufferPool;
+class RealtimeThread;
+
 //==============================================================================
 /**
     The juce::UnitTest which will create the plugins and run each of the registered tests on them.
@@ -40,6 +43,18 @@ struct PluginTests : public juce::UnitTest
         std::vector<double> sampleRates;    /**< List of sample rates. */
         std::vector<int> blockSizes;        /**< List of block sizes. */
         juce::File vst3Validator;                 /**< juce::File to use as the VST3 validator app. */
+        bool lockMemory = false;            /**< Whether to lock all process memory in to RAM (mlockall) before running the tests. */
+        bool realtimeThread = false;        /**< Whether to run the audio processing tests on a dedicated real-time thread. */
+        int realtimePriority = 80;          /**< The SCHED_FIFO priority to use for the real-time thread. */
+        int realtimeCpuCore = -1;           /**< The CPU core to pin the real-time thread to, -1 for no affinity. */
+        bool performanceCounters = false;   /**< Whether to read hardware performance counters around processBlock calls. */
+        int messageThreadStallThresholdMs = 0;  /**< Fail a test if it blocks the message thread for longer than this, 0 to only report stalls. */
+        int chainLength = 0;                /**< Number of plugin instances to run in series in the plugin chain benchmark, 0 to skip it. */
+        juce::StringArray chainPlugins;     /**< Other plugins (paths or IDs) to interleave with the one being tested in the plugin chain. */
+        int cacheEvictionSizeKb = 0;        /**< Size of the buffer written between processBlock calls in the cold cache benchmark, 0 to skip it. */
+        int stressThreads = 0;              /**< Number of background threads to run in the contention benchmark, 0 to skip it. */
+        int stressIntensity = 100;          /**< Percentage of the time the contention stressor threads are busy for. */
+        int minimumBufferSeconds = 2;       /**< Seconds of simulated audio callbacks to run at each block size in the minimum buffer size benchmark. */
     };
 
     /** Creates a set of tests for a fileOrIdentifier. */
@@ -48,6 +63,9 @@ struct PluginTests : public juce::UnitTest
     /** Creates a set of tests for a PluginDescription. */
     PluginTests (const juce::PluginDescription&, Options);
 
+    /** Destructor. */
+    ~PluginTests() override;
+
     /** Returns the file or ID used to create this. */
     juce::String getFileOrID() const;
 
@@ -64,6 +82,38 @@ struct PluginTests : public juce::UnitTest
     /** Resets the timeout. Call this from long tests that don't log messages. */
     void resetTimeout();
 
+    /** Returns buffers preallocated for the largest channel count and block size
+        the tests will use. Take buffers from this rather than creating them for
+        each configuration so the harness doesn't allocate whilst processing.
+    */
+    ProcessingBufferPool& getBufferPool();
+
+    /** Returns the automatable parameters of the plugin being tested, excluding
+        the bypass parameter. This is rebuilt before each test runs so it can be
+        used from processing loops without allocating. Tests that make the plugin
+        change its parameter list shouldn't use it after doing so.
+    */
+    const juce::Array<juce::AudioProcessorParameter*>& getAutomatableParameters() const     { return automatableParameters; }
+
+    /** Creates another instance of a plugin, e.g. to run alongside the one being tested.
+        Returns nullptr and sets the errorMessage if the plugin couldn't be created.
+    */
+    std::unique_ptr<juce::AudioPluginInstance> createPluginInstance (const juce::PluginDescription&,
+                                                                     double sampleRate, int blockSize,
+                                                                     juce::String& errorMessage);
+
+    /** Scans a plugin file or identifier on the message thread and returns the
+        descriptions of the plugins it contains.
+    */
+    juce::OwnedArray<juce::PluginDescription> findPluginDescriptions (const juce::String& fileOrIdentifier);
+
+    /** Calls a function on the real-time audio thread if one is enabled in the
+        options, otherwise calls it directly, blocking until it has completed.
+        Tests that need to create instances or change layouts can run on a
+        background thread and use this for just the processing they time.
+    */
+    void callOnAudioThread (const std::function<void()>&);
+
     //==============================================================================
     /** @internal. */
     void runTest() override;
@@ -75,6 +125,9 @@ private:
     juce::KnownPluginList knownPluginList;
 
     juce::OwnedArray<juce::PluginDescription> typesFound;
+    std::unique_ptr<ProcessingBufferPool> bufferPool;
+    juce::Array<juce::AudioProcessorParameter*> automatableParameters;
+    std::unique_ptr<RealtimeThread> audioThread;
 
     std::unique_ptr<juce::AudioPluginInstance> testOpenPlugin (const juce::PluginDescription&);
     void testType (const juce::PluginDescription&);
@@ -95,12 +148,14 @@ struct PluginTest
     struct Requirements
     {
         /** By default tests are run on a background thread. Set this if you need
-            the runTest method to be called on the message thread.
+            the runTest method to be called on the message thread or if the test
+            processes audio and should be run on the real-time thread, if enabled.
          */
         enum class Thread
         {
             backgroundThread,       /**< Test can run on a background thread. */
-            messageThread           /**< Test needs to run on the message thread. */
+            messageThread,          /**< Test needs to run on the message thread. */
+            audioThread             /**< Test processes audio so runs on the real-time thread if enabled, otherwise a background thread. */
         };
 
         /** Some test environments may not allow gui windows.
@@ -154,6 +209,12 @@ struct PluginTest
         return requirements.thread == Requirements::Thread::messageThread;
     }
 
+    /** Returns true if the runTest method should be called on the real-time audio thread if one is enabled. */
+    bool needsToRunOnAudioThread() const
+    {
+        return requirements.thread == Requirements::Thread::audioThread;
+    }
+
     /** Returns true if the test needs a GUI environment to run. */
     bool requiresGUI() const
     {
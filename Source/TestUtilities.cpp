@@ -12,139 +12,1407 @@
 
  ==============================================================================*/
 
+#include <cstring>
 #include <future>
+#include <numeric>
 #include "TestUtilities.h"
+#include "PluginTests.h"
+
+#if JUCE_LINUX || JUCE_MAC || JUCE_BSD
+ #include <pthread.h>
+ #include <sched.h>
+ #include <sys/mman.h>
+ #include <sys/resource.h>
+#endif
+
+#if JUCE_LINUX
+ #include <linux/perf_event.h>
+ #include <sys/ioctl.h>
+ #include <sys/syscall.h>
+ #include <unistd.h>
+#endif
 
 inline bool logAllocationViolationIfNotAllowed()
 {
-    auto& ai = getAllocatorInterceptor();
+    auto& ai = getAllocatorInterceptor();
+
+    if (! ai.isAllowedToAllocate())
+    {
+        ai.logAllocationViolation();
+        return false;
+    }
+
+    return true;
+}
+
+inline void violationError (const std::string& text)
+{
+    switch (AllocatorInterceptor::getViolationBehaviour())
+    {
+        case AllocatorInterceptor::ViolationBehaviour::logToCerr:
+            std::cerr << text;
+            break;
+        case AllocatorInterceptor::ViolationBehaviour::throwException:
+            throw;
+            break;
+        case AllocatorInterceptor::ViolationBehaviour::none:
+        default:
+            break;
+    }
+}
+
+inline bool throwIfRequiredAndReturnShouldLog()
+{
+    switch (AllocatorInterceptor::getViolationBehaviour())
+    {
+        case AllocatorInterceptor::ViolationBehaviour::logToCerr:
+            return true;
+        case AllocatorInterceptor::ViolationBehaviour::throwException:
+            throw std::bad_alloc();
+        case AllocatorInterceptor::ViolationBehaviour::none:
+        default:
+            break;
+    }
+
+    return false;
+}
+
+inline void logViolation (AllocationViolation::Type type, std::size_t size) noexcept
+{
+    auto& log = AllocationViolationLog::getInstance();
+    log.push ({ type, size,
+                juce::Time::getHighResolutionTicks(),
+                juce::Thread::getCurrentThreadId(),
+                log.getCurrentTestIndex(),
+                getAllocatorInterceptor().getBlockIndex() });
+}
+
+//==============================================================================
+#if JUCE_CLANG
+ #define ATTRIBUTE_USED __attribute__((used))
+#else
+ #define ATTRIBUTE_USED
+#endif
+
+ATTRIBUTE_USED void* operator new (std::size_t sz)
+{
+    if (! logAllocationViolationIfNotAllowed())
+        if (throwIfRequiredAndReturnShouldLog())
+            logViolation (AllocationViolation::Type::allocation, sz);
+
+    return std::malloc (sz);
+}
+
+ATTRIBUTE_USED void* operator new[] (std::size_t sz)
+{
+    if (! logAllocationViolationIfNotAllowed())
+        if (throwIfRequiredAndReturnShouldLog())
+            logViolation (AllocationViolation::Type::arrayAllocation, sz);
+
+    return std::malloc (sz);
+}
+
+ATTRIBUTE_USED void operator delete (void* ptr) noexcept
+{
+    if (! logAllocationViolationIfNotAllowed())
+        if (throwIfRequiredAndReturnShouldLog())
+            logViolation (AllocationViolation::Type::deletion, 0);
+
+    std::free (ptr);
+}
+
+ATTRIBUTE_USED void operator delete[] (void* ptr) noexcept
+{
+    if (! logAllocationViolationIfNotAllowed())
+        if (throwIfRequiredAndReturnShouldLog())
+            logViolation (AllocationViolation::Type::arrayDeletion, 0);
+
+    std::free (ptr);
+}
+
+#if JUCE_CXX14_IS_AVAILABLE
+void operator delete (void* ptr, size_t sz) noexcept
+{
+    if (! logAllocationViolationIfNotAllowed())
+        if (throwIfRequiredAndReturnShouldLog())
+            logViolation (AllocationViolation::Type::deletion, sz);
+
+    std::free (ptr);
+}
+
+void operator delete[] (void* ptr, size_t sz) noexcept
+{
+    if (! logAllocationViolationIfNotAllowed())
+        if (throwIfRequiredAndReturnShouldLog())
+            logViolation (AllocationViolation::Type::arrayDeletion, sz);
+
+    std::free (ptr);
+}
+#endif
+
+//==============================================================================
+struct MessageThreadWatchdog::State
+{
+    State()
+    {
+        reset();
+    }
+
+    void reset()
+    {
+        for (auto& count : histogram)
+            count = 0;
+
+        worstLatencyTicks = 0;
+        numHeartbeats = 0;
+
+        // Only count the part of any pending heartbeat's latency from now
+        if (heartbeatPending)
+            postTicks = juce::Time::getHighResolutionTicks();
+    }
+
+    void post()
+    {
+        postTicks = juce::Time::getHighResolutionTicks();
+        heartbeatPending = true;
+    }
+
+    void dispatched()
+    {
+        const auto latencyTicks = juce::Time::getHighResolutionTicks() - postTicks.load();
+        const auto latencyMs = juce::Time::highResolutionTicksToSeconds (latencyTicks) * 1000.0;
+
+        int bucket = 0;
+
+        while (bucket < numHistogramBuckets - 1 && latencyMs >= Results::getBucketLimitMs (bucket))
+            ++bucket;
+
+        ++histogram[(size_t) bucket];
+        ++numHeartbeats;
+
+        if (latencyTicks > worstLatencyTicks)
+            worstLatencyTicks = latencyTicks;
+
+        heartbeatPending = false;
+    }
+
+    std::array<std::atomic<int>, numHistogramBuckets> histogram;
+    std::atomic<juce::int64> worstLatencyTicks { 0 }, postTicks { 0 };
+    std::atomic<int> numHeartbeats { 0 };
+    std::atomic<bool> heartbeatPending { false };
+};
+
+MessageThreadWatchdog::MessageThreadWatchdog (int heartbeatIntervalMs)
+    : juce::Thread ("MessageThreadWatchdog"),
+      state (std::make_shared<State>()),
+      intervalMs (heartbeatIntervalMs)
+{
+    startThread (juce::Thread::Priority::high);
+}
+
+MessageThreadWatchdog::~MessageThreadWatchdog()
+{
+    stopThread (5000);
+}
+
+void MessageThreadWatchdog::reset()
+{
+    state->reset();
+}
+
+MessageThreadWatchdog::Results MessageThreadWatchdog::getResults (bool includePendingHeartbeat) const
+{
+    Results results;
+    auto worstTicks = state->worstLatencyTicks.load();
+
+    if (includePendingHeartbeat && state->heartbeatPending)
+        worstTicks = std::max (worstTicks, juce::Time::getHighResolutionTicks() - state->postTicks.load());
+
+    results.worstStallMs = juce::Time::highResolutionTicksToSeconds (worstTicks) * 1000.0;
+    results.numHeartbeats = state->numHeartbeats;
+
+    for (size_t i = 0; i < results.histogram.size(); ++i)
+        results.histogram[i] = state->histogram[i];
+
+    return results;
+}
+
+void MessageThreadWatchdog::run()
+{
+    while (! threadShouldExit())
+    {
+        // Only post a new heartbeat once the last one has arrived so a blocked
+        // message thread doesn't get flooded
+        if (! state->heartbeatPending)
+        {
+            state->post();
+            juce::MessageManager::callAsync ([s = state] { s->dispatched(); });
+        }
+
+        wait (intervalMs);
+    }
+}
+
+double MessageThreadWatchdog::Results::getBucketLimitMs (int bucketIndex)
+{
+    constexpr double limits[numHistogramBuckets - 1] = { 1.0, 2.0, 5.0, 10.0, 20.0, 50.0, 100.0, 200.0, 500.0, 1000.0 };
+
+    if (juce::isPositiveAndBelow (bucketIndex, numHistogramBuckets - 1))
+        return limits[bucketIndex];
+
+    return std::numeric_limits<double>::infinity();
+}
+
+juce::String MessageThreadWatchdog::Results::getDescription() const
+{
+    juce::StringArray buckets;
+
+    for (int i = 0; i < numHistogramBuckets; ++i)
+    {
+        if (histogram[(size_t) i] == 0)
+            continue;
+
+        const auto limitName = i < numHistogramBuckets - 1 ? "<" + juce::String (getBucketLimitMs (i), 0) + "ms"
+                                                           : ">=" + juce::String (getBucketLimitMs (i - 1), 0) + "ms";
+        buckets.add (limitName + ": " + juce::String (histogram[(size_t) i]));
+    }
+
+    return "Message thread worst stall: " + juce::String (worstStallMs, 1) + " ms, "
+            + juce::String (numHeartbeats) + " heartbeats (" + buckets.joinIntoString (", ") + ")";
+}
+
+//==============================================================================
+struct ContentionStressor::StressThread  : public juce::Thread
+{
+    StressThread (ContentionStressor& cs, Workload w, int intensity)
+        : juce::Thread ("pluginval stressor"),
+          owner (cs), workload (w), busyMs (periodMs * juce::jlimit (1, 100, intensity) / 100.0)
+    {
+    }
+
+    ~StressThread() override
+    {
+        stopThread (1000);
+    }
+
+    void run() override
+    {
+        if (workload == Workload::memoryBandwidth)
+            memory.resize (32 * 1024 * 1024);
+
+        while (! threadShouldExit())
+        {
+            const auto startMs = juce::Time::getMillisecondCounterHiRes();
+
+            while (juce::Time::getMillisecondCounterHiRes() - startMs < busyMs && ! threadShouldExit())
+                doWork();
+
+            if (busyMs < periodMs)
+                wait (juce::roundToInt (periodMs - busyMs));
+        }
+    }
+
+    void doWork()
+    {
+        switch (workload)
+        {
+            case Workload::cpu:
+            {
+                for (int i = 0; i < 4096; ++i)
+                {
+                    state ^= state << 13;
+                    state ^= state >> 7;
+                    state ^= state << 17;
+                }
+
+                sink = state;
+                break;
+            }
+
+            case Workload::memoryBandwidth:
+            {
+                // Copy 1 MB at a time from one half of the buffer to the other
+                constexpr size_t chunkSize = 1024 * 1024;
+                const auto halfSize = memory.size() / 2;
+
+                std::memcpy (memory.data() + halfSize + position, memory.data() + position, chunkSize);
+                position = (position + chunkSize) % halfSize;
+                break;
+            }
+
+            case Workload::lockContention:
+            {
+                const std::lock_guard<std::mutex> lock (owner.sharedLock);
+
+                for (int i = 0; i < 64; ++i)
+                    owner.sharedCounter.fetch_add (1, std::memory_order_relaxed);
+
+                break;
+            }
+        }
+    }
+
+    static constexpr double periodMs = 10.0;
+
+    ContentionStressor& owner;
+    const Workload workload;
+    const double busyMs;
+    std::vector<char> memory;
+    size_t position = 0;
+    juce::uint64 state = 0x9e3779b97f4a7c15;
+    volatile juce::uint64 sink = 0;
+};
+
+juce::String ContentionStressor::getName (Workload workload)
+{
+    switch (workload)
+    {
+        case Workload::cpu:                 return "CPU";
+        case Workload::memoryBandwidth:     return "memory bandwidth";
+        case Workload::lockContention:      return "lock contention";
+    }
+
+    return {};
+}
+
+ContentionStressor::ContentionStressor (Workload workload, int numThreads, int intensityPercent)
+{
+    for (int i = 0; i < numThreads; ++i)
+        threads.add (new StressThread (*this, workload, intensityPercent))->startThread();
+}
+
+ContentionStressor::~ContentionStressor()
+{
+    for (auto t : threads)
+        t->signalThreadShouldExit();
+
+    threads.clear();
+}
+
+//==============================================================================
+std::atomic<AllocatorInterceptor::ViolationBehaviour> AllocatorInterceptor::violationBehaviour (ViolationBehaviour::logToCerr);
+
+void AllocatorInterceptor::setViolationBehaviour (ViolationBehaviour behaviour) noexcept
+{
+    violationBehaviour.store (behaviour);
+}
+
+AllocatorInterceptor::ViolationBehaviour AllocatorInterceptor::getViolationBehaviour() noexcept
+{
+    return violationBehaviour.load();
+}
+
+AllocatorInterceptor& getAllocatorInterceptor()
+{
+    thread_local AllocatorInterceptor ai;
+    return ai;
+}
+
+//==============================================================================
+AllocationViolationLog& AllocationViolationLog::getInstance()
+{
+    static AllocationViolationLog log;
+    return log;
+}
+
+AllocationViolationLog::AllocationViolationLog()
+{
+    for (std::size_t i = 0; i < capacity; ++i)
+        slots[i].sequence.store (i, std::memory_order_relaxed);
+}
+
+bool AllocationViolationLog::push (const AllocationViolation& violation) noexcept
+{
+    auto position = writePosition.load (std::memory_order_relaxed);
+
+    for (;;)
+    {
+        auto& slot = slots[position % capacity];
+        const auto sequence = slot.sequence.load (std::memory_order_acquire);
+        const auto diff = (std::ptrdiff_t) sequence - (std::ptrdiff_t) position;
+
+        if (diff == 0)
+        {
+            if (writePosition.compare_exchange_weak (position, position + 1, std::memory_order_relaxed))
+            {
+                slot.violation = violation;
+                slot.sequence.store (position + 1, std::memory_order_release);
+                return true;
+            }
+        }
+        else if (diff < 0)
+        {
+            ++numDropped;
+            return false;
+        }
+        else
+        {
+            position = writePosition.load (std::memory_order_relaxed);
+        }
+    }
+}
+
+bool AllocationViolationLog::pop (AllocationViolation& violation) noexcept
+{
+    const auto position = readPosition.load (std::memory_order_relaxed);
+    auto& slot = slots[position % capacity];
+
+    if (slot.sequence.load (std::memory_order_acquire) != position + 1)
+        return false;
+
+    violation = slot.violation;
+    slot.sequence.store (position + capacity, std::memory_order_release);
+    readPosition.store (position + 1, std::memory_order_relaxed);
+
+    return true;
+}
+
+int AllocationViolationLog::getAndClearNumDropped() noexcept
+{
+    return numDropped.exchange (0);
+}
+
+void AllocationViolationLog::setCurrentTest (const juce::String& testName)
+{
+    const juce::ScopedLock sl (testNamesLock);
+    testNames.add (testName);
+    currentTestIndex = testNames.size() - 1;
+}
+
+int AllocationViolationLog::getCurrentTestIndex() const noexcept
+{
+    return currentTestIndex.load();
+}
+
+juce::String AllocationViolationLog::getTestName (int testIndex) const
+{
+    const juce::ScopedLock sl (testNamesLock);
+    return testNames[testIndex];
+}
+
+//==============================================================================
+AllocationViolationLogger::AllocationViolationLogger()
+    : juce::Thread ("AllocationViolationLogger"),
+      startTicks (juce::Time::getHighResolutionTicks())
+{
+    startThread (juce::Thread::Priority::low);
+}
+
+AllocationViolationLogger::~AllocationViolationLogger()
+{
+    stopThread (5000);
+    logPendingViolations();
+}
+
+void AllocationViolationLogger::logPendingViolations()
+{
+    auto& log = AllocationViolationLog::getInstance();
+    AllocationViolation violation;
+
+    while (log.pop (violation))
+    {
+        const auto description = [&violation]() -> juce::String
+        {
+            switch (violation.type)
+            {
+                case AllocationViolation::Type::allocation:         return "allocation of " + juce::String (violation.size) + " bytes";
+                case AllocationViolation::Type::arrayAllocation:    return "array allocation of " + juce::String (violation.size) + " bytes";
+                case AllocationViolation::Type::deletion:           return "deletion";
+                case AllocationViolation::Type::arrayDeletion:      return "array deletion";
+            }
+
+            return {};
+        }();
+
+        const auto timeMs = juce::Time::highResolutionTicksToSeconds (violation.timeTicks - startTicks) * 1000.0;
+        const auto testName = log.getTestName (violation.testIndex);
+
+        std::cerr << "!!! WARNING: Illegal " << description
+                  << " [test: " << (testName.isNotEmpty() ? testName : juce::String ("unknown"))
+                  << ", block: " << violation.blockIndex
+                  << ", thread: 0x" << juce::String::toHexString ((juce::pointer_sized_int) violation.threadID)
+                  << ", time: " << juce::String (timeMs, 3) << " ms]\n";
+    }
+
+    if (const auto numDropped = log.getAndClearNumDropped(); numDropped > 0)
+        std::cerr << "!!! WARNING: " << numDropped << " further allocation violations were not logged as the log was full\n";
+}
+
+void AllocationViolationLogger::run()
+{
+    while (! threadShouldExit())
+    {
+        logPendingViolations();
+        wait (50);
+    }
+}
+
+//==============================================================================
+void ProcessingBufferPool::reserve (int maxNumChannels, int maxBlockSize, int midiBufferBytes)
+{
+    if (maxNumChannels > numChannelsReserved || maxBlockSize > blockSizeReserved)
+    {
+        numChannelsReserved = juce::jmax (numChannelsReserved, maxNumChannels);
+        blockSizeReserved = juce::jmax (blockSizeReserved, maxBlockSize);
+        audioBuffer.setSize (numChannelsReserved, blockSizeReserved);
+    }
+
+    if (midiBufferBytes > midiBytesReserved)
+    {
+        midiBytesReserved = midiBufferBytes;
+        midiBuffer.ensureSize ((size_t) midiBytesReserved);
+    }
+}
+
+juce::AudioBuffer<float>& ProcessingBufferPool::getAudioBuffer (int numChannels, int numSamples)
+{
+    // This only happens if a bus layout change increased the channel count
+    reserve (numChannels, numSamples, midiBytesReserved);
+
+    audioBuffer.setSize (numChannels, numSamples, false, false, true);
+    audioBuffer.clear();
+
+    return audioBuffer;
+}
+
+juce::MidiBuffer& ProcessingBufferPool::getMidiBuffer()
+{
+    midiBuffer.clear();
+    return midiBuffer;
+}
+
+//==============================================================================
+double TimingStatistics::getMean() const noexcept
+{
+    if (timings.empty())
+        return 0.0;
+
+    return std::accumulate (timings.begin(), timings.end(), 0.0) / (double) timings.size();
+}
+
+double TimingStatistics::getMax() const noexcept
+{
+    return timings.empty() ? 0.0 : *std::max_element (timings.begin(), timings.end());
+}
+
+double TimingStatistics::getPercentile (double percentile) const
+{
+    if (timings.empty())
+        return 0.0;
+
+    auto sorted = timings;
+    const auto rank = (size_t) std::ceil (juce::jlimit (0.0, 100.0, percentile) / 100.0 * (double) sorted.size());
+    const auto index = rank > 0 ? rank - 1 : 0;
+    std::nth_element (sorted.begin(), sorted.begin() + (std::ptrdiff_t) index, sorted.end());
+
+    return sorted[index];
+}
+
+juce::String TimingStatistics::getDescription() const
+{
+    auto toMicroseconds = [] (double seconds) { return juce::String (seconds * 1.0e6, 1) + " us"; };
+
+    return "mean: " + toMicroseconds (getMean())
+            + ", median: " + toMicroseconds (getPercentile (50.0))
+            + ", 99th: " + toMicroseconds (getPercentile (99.0))
+            + ", max: " + toMicroseconds (getMax());
+}
+
+//==============================================================================
+LinearFit fitLine (const std::vector<double>& x, const std::vector<double>& y, bool weightByInverseY)
+{
+    jassert (x.size() == y.size());
+    double sumW = 0.0, sumWX = 0.0, sumWY = 0.0, sumWXX = 0.0, sumWXY = 0.0;
+
+    for (size_t i = 0; i < juce::jmin (x.size(), y.size()); ++i)
+    {
+        const auto w = (weightByInverseY && y[i] > 0.0) ? 1.0 / (y[i] * y[i]) : 1.0;
+        sumW += w;
+        sumWX += w * x[i];
+        sumWY += w * y[i];
+        sumWXX += w * x[i] * x[i];
+        sumWXY += w * x[i] * y[i];
+    }
+
+    LinearFit fit;
+    const auto denominator = sumW * sumWXX - sumWX * sumWX;
+
+    if (sumW <= 0.0)
+        return fit;
+
+    if (std::abs (denominator) > 0.0)
+        fit.slope = (sumW * sumWXY - sumWX * sumWY) / denominator;
+
+    fit.intercept = (sumWY - fit.slope * sumWX) / sumW;
+    return fit;
+}
+
+//==============================================================================
+NoiseGenerator::NoiseGenerator (juce::int64 seed) noexcept
+{
+    // splitmix64 spreads the single seed over every lane's state
+    auto x = (uint64_t) seed;
+
+    auto nextSeed = [&x]
+    {
+        auto z = (x += 0x9e3779b97f4a7c15ull);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+        return z ^ (z >> 31);
+    };
+
+    for (int lane = 0; lane < numLanes; ++lane)
+    {
+        const auto a = nextSeed(), b = nextSeed();
+        s0[lane] = (uint32_t) a;
+        s1[lane] = (uint32_t) (a >> 32);
+        s2[lane] = (uint32_t) b;
+        s3[lane] = (uint32_t) (b >> 32);
+    }
+}
+
+void NoiseGenerator::fill (float* dest, int numSamples) noexcept
+{
+    int i = 0;
+
+    for (; i + numLanes <= numSamples; i += numLanes)
+        generate (dest + i);
+
+    if (i < numSamples)
+    {
+        float remainder[numLanes];
+        generate (remainder);
+        std::copy (remainder, remainder + (numSamples - i), dest + i);
+    }
+}
+
+void NoiseGenerator::generate (float* dest) noexcept
+{
+    for (int lane = 0; lane < numLanes; ++lane)
+    {
+        const uint32_t result = s0[lane] + s3[lane];
+        const uint32_t t = s1[lane] << 9;
+
+        s2[lane] ^= s0[lane];
+        s3[lane] ^= s1[lane];
+        s1[lane] ^= s2[lane];
+        s0[lane] ^= s3[lane];
+        s2[lane] ^= t;
+        s3[lane] = (s3[lane] << 11) | (s3[lane] >> 21);
+
+        // The top 23 bits become the mantissa of a float in [1, 2)
+        const uint32_t bits = (result >> 9) | 0x3f800000u;
+        float sample;
+        std::memcpy (&sample, &bits, sizeof (sample));
+        dest[lane] = sample * 2.0f - 3.0f;
+    }
+}
+
+//==============================================================================
+NoiseBank::NoiseBank (juce::Random& r, int numSamples)
+    : samples ((size_t) juce::jmax (1, numSamples))
+{
+    NoiseGenerator (r.nextInt64()).fill (samples.data(), (int) samples.size());
+}
+
+void NoiseBank::fill (juce::AudioBuffer<float>& ab) noexcept
+{
+    for (int c = 0; c < ab.getNumChannels(); ++c)
+        fill (ab.getWritePointer (c), ab.getNumSamples());
+}
+
+void NoiseBank::fill (float* dest, int numSamples) noexcept
+{
+    const int bankSize = (int) samples.size();
+
+    while (numSamples > 0)
+    {
+        const int numThisTime = juce::jmin (numSamples, bankSize - readPosition);
+        std::copy_n (samples.data() + readPosition, numThisTime, dest);
+
+        dest += numThisTime;
+        numSamples -= numThisTime;
+        readPosition = (readPosition + numThisTime) % bankSize;
+    }
+
+    // Skip a prime number of samples so successive reads don't line up with block boundaries
+    readPosition = (readPosition + 7919) % bankSize;
+}
+
+//==============================================================================
+namespace
+{
+    /** Each lane accumulates every numLanes'th sample so the inner loop has no
+        cross-lane dependencies and compiles down to packed integer and float ops.
+    */
+    struct BufferAnalysisLanes
+    {
+        static constexpr int numLanes = 8;
+
+        uint32_t nans[numLanes] {}, infs[numLanes] {}, subnormals[numLanes] {};
+        float peaks[numLanes] {}, sums[numLanes] {}, sumsOfSquares[numLanes] {};
+
+        void accumulate (const float* data, int numSamples) noexcept
+        {
+            int i = 0;
+
+            for (; i + numLanes <= numSamples; i += numLanes)
+                for (int lane = 0; lane < numLanes; ++lane)
+                    accumulate (lane, data[i + lane]);
+
+            for (int lane = 0; i < numSamples; ++i, ++lane)
+                accumulate (lane, data[i]);
+        }
+
+        inline void accumulate (int lane, float sample) noexcept
+        {
+            uint32_t bits;
+            std::memcpy (&bits, &sample, sizeof (bits));
+
+            const auto exponent = bits & 0x7f800000u;
+            const auto mantissa = bits & 0x007fffffu;
+            const uint32_t isNonFinite = exponent == 0x7f800000u ? 1u : 0u;
+            const uint32_t hasMantissa = mantissa != 0 ? 1u : 0u;
+
+            nans[lane] += isNonFinite & hasMantissa;
+            infs[lane] += isNonFinite & (hasMantissa ^ 1u);
+            subnormals[lane] += (exponent == 0 ? 1u : 0u) & hasMantissa;
+
+            // Non-finite samples are masked to zero so they don't poison the levels
+            const uint32_t finiteBits = bits & (isNonFinite - 1u);
+            const uint32_t absBits = finiteBits & 0x7fffffffu;
+            float finiteSample, absSample;
+            std::memcpy (&finiteSample, &finiteBits, sizeof (finiteSample));
+            std::memcpy (&absSample, &absBits, sizeof (absSample));
+
+            peaks[lane] = absSample > peaks[lane] ? absSample : peaks[lane];
+            sums[lane] += finiteSample;
+            sumsOfSquares[lane] += finiteSample * finiteSample;
+        }
+    };
+}
+
+BufferAnalysis analyseBuffer (const juce::AudioBuffer<float>& ab) noexcept
+{
+    BufferAnalysis analysis;
+    const int numSamples = ab.getNumSamples();
+    double sum = 0.0, sumOfSquares = 0.0;
+    int64_t numFinite = 0;
+
+    for (int c = 0; c < ab.getNumChannels(); ++c)
+    {
+        // Per-channel lanes keep the float accumulators short enough to stay accurate
+        BufferAnalysisLanes lanes;
+        lanes.accumulate (ab.getReadPointer (c), numSamples);
+
+        int numNonFinite = 0;
+
+        for (int lane = 0; lane < BufferAnalysisLanes::numLanes; ++lane)
+        {
+            analysis.numNaNs += (int) lanes.nans[lane];
+            analysis.numInfs += (int) lanes.infs[lane];
+            analysis.numSubnormals += (int) lanes.subnormals[lane];
+            numNonFinite += (int) (lanes.nans[lane] + lanes.infs[lane]);
+
+            analysis.peak = std::max (analysis.peak, lanes.peaks[lane]);
+            sum += lanes.sums[lane];
+            sumOfSquares += lanes.sumsOfSquares[lane];
+        }
+
+        numFinite += numSamples - numNonFinite;
+    }
+
+    if (numFinite > 0)
+    {
+        analysis.dc = (float) (sum / (double) numFinite);
+        analysis.rms = (float) std::sqrt (sumOfSquares / (double) numFinite);
+    }
+
+    return analysis;
+}
+
+juce::String BufferAnalysis::getDescription() const
+{
+    auto toDecibels = [] (float level) { return juce::String (juce::Decibels::gainToDecibels (level), 1) + " dB"; };
+
+    return "peak: " + toDecibels (peak)
+            + ", RMS: " + toDecibels (rms)
+            + ", DC: " + juce::String (dc, 6);
+}
+
+void expectValidBuffer (juce::UnitTest& ut, const BufferAnalysis& analysis)
+{
+    ut.expectEquals (analysis.numNaNs, 0, "NaNs found in buffer");
+    ut.expectEquals (analysis.numInfs, 0, "Infs found in buffer");
+    ut.expectEquals (analysis.numSubnormals, 0, "Subnormals found in buffer");
+}
+
+//==============================================================================
+StimulusLibrary::StimulusLibrary (juce::Random& r, int numSamples)
+    : noise (r, numSamples)
+{
+    numSamples = juce::jmax (1, numSamples);
+
+    for (auto& signal : signals)
+        signal.resize ((size_t) numSamples, 0.0f);
+
+    const auto halfLength = (size_t) numSamples / 2;
+    NoiseGenerator (r.nextInt64()).fill (signals[silenceToSignal].data() + halfLength, numSamples - (int) halfLength);
+
+    std::fill (signals[fullScaleDC].begin(), signals[fullScaleDC].end(), 1.0f);
+
+    for (size_t i = 0; i < signals[impulses].size(); i += 1021)
+        signals[impulses][i] = 1.0f;
+
+    {
+        // Exponential sweep so that most of the time is spent closest to Nyquist
+        const double startFrequency = 0.4, endFrequency = 0.4995;
+        double phase = 0.0;
+
+        for (int i = 0; i < numSamples; ++i)
+        {
+            const auto frequency = startFrequency * std::pow (endFrequency / startFrequency, i / (double) numSamples);
+            signals[nyquistSweep][(size_t) i] = (float) (0.9 * std::sin (phase));
+            phase = std::fmod (phase + juce::MathConstants<double>::twoPi * frequency, juce::MathConstants<double>::twoPi);
+        }
+    }
+
+    // Samples alternate between +/-1 but the reconstructed waveform peaks at +/-sqrt(2)
+    for (int i = 0; i < numSamples; ++i)
+        signals[interSamplePeaks][(size_t) i] = (i % 4) < 2 ? 1.0f : -1.0f;
+}
+
+juce::String StimulusLibrary::getName (Type type)
+{
+    switch (type)
+    {
+        case whiteNoise:        return "White noise";
+        case silence:           return "Silence";
+        case silenceToSignal:   return "Silence to signal";
+        case fullScaleDC:       return "Full-scale DC";
+        case impulses:          return "Impulses";
+        case nyquistSweep:      return "Near-Nyquist sweep";
+        case interSamplePeaks:  return "Inter-sample peaks";
+        case numTypes:
+        default:                break;
+    }
+
+    jassertfalse;
+    return {};
+}
+
+void StimulusLibrary::fill (Type type, juce::AudioBuffer<float>& ab) noexcept
+{
+    if (type == whiteNoise)
+    {
+        noise.fill (ab);
+        return;
+    }
+
+    const auto& signal = signals[(size_t) type];
+    const int signalSize = (int) signal.size();
+    auto& readPosition = readPositions[(size_t) type];
+    const int numSamples = ab.getNumSamples();
+
+    for (int c = 0; c < ab.getNumChannels(); ++c)
+    {
+        auto dest = ab.getWritePointer (c);
+        int position = readPosition;
+
+        for (int numDone = 0; numDone < numSamples;)
+        {
+            const int numThisTime = juce::jmin (numSamples - numDone, signalSize - position);
+            std::copy_n (signal.data() + position, numThisTime, dest + numDone);
+
+            numDone += numThisTime;
+            position = (position + numThisTime) % signalSize;
+        }
+    }
+
+    readPosition = (readPosition + numSamples) % signalSize;
+}
+
+//==============================================================================
+void StimulusResults::add (double seconds, const BufferAnalysis& analysis)
+{
+    timing.add (seconds);
+    ++numBlocks;
+    numNaNs += analysis.numNaNs;
+    numInfs += analysis.numInfs;
+    numSubnormals += analysis.numSubnormals;
+    peak = std::max (peak, analysis.peak);
+}
+
+juce::String StimulusResults::getDescription() const
+{
+    auto description = timing.getDescription()
+                        + ", output peak: " + juce::String (juce::Decibels::gainToDecibels (peak), 1) + " dB";
+
+    if (numNaNs > 0)        description << ", NaNs: " << numNaNs;
+    if (numInfs > 0)        description << ", Infs: " << numInfs;
+    if (numSubnormals > 0)  description << ", subnormals: " << numSubnormals;
+
+    return description;
+}
+
+//==============================================================================
+CacheEvictor::CacheEvictor (size_t numBytes)
+    : buffer (numBytes)
+{
+}
+
+void CacheEvictor::evict() noexcept
+{
+    // Writing rather than reading means the lines are dirty so have to be written
+    // back when evicted, as they would be after other plugins' processing
+    constexpr size_t cacheLineSize = 64;
+    auto* data = static_cast<volatile unsigned char*> (buffer.data());
+    ++counter;
+
+    for (size_t i = 0; i < buffer.size(); i += cacheLineSize)
+        data[i] = counter;
+}
+
+//==============================================================================
+double timeProcessBlockWithoutAllocating (juce::AudioPluginInstance& instance, juce::AudioBuffer<float>& ab,
+                                          juce::MidiBuffer& mb, int& numAllocations)
+{
+    double seconds = 0.0;
+
+    {
+        ScopedAllocationDisabler sad;
+        seconds = timeProcessBlock (instance, ab, mb);
+    }
+
+    auto& ai = getAllocatorInterceptor();
+    numAllocations += ai.getAndClearNumAllocationViolations();
+    ai.getAndClearAllocationViolation();
+
+    return seconds;
+}
+
+void checkAllocations (PluginTests& ut, int numAllocations, const juce::String& whilst)
+{
+    if (numAllocations == 0)
+        return;
+
+    const auto message = juce::String (numAllocations) + " allocations whilst " + whilst;
+
+    if (ut.getOptions().strictnessLevel > 8)
+        ut.expectEquals (numAllocations, 0, message);
+    else
+        ut.logMessage ("!!! WARNING: " + message);
+}
+
+CallbackDeadlineResults simulateAudioCallbacks (const std::function<void()>& callback,
+                                                double periodSeconds, int numCallbacks,
+                                                double deadlineProportion)
+{
+    CallbackDeadlineResults results;
+    results.timings.reserve (numCallbacks);
+
+    const auto periodTicks = juce::Time::secondsToHighResolutionTicks (periodSeconds);
+    const auto deadlineTicks = juce::Time::secondsToHighResolutionTicks (periodSeconds * deadlineProportion);
+    auto nextCallbackTicks = juce::Time::getHighResolutionTicks();
+
+    for (int i = 0; i < numCallbacks; ++i)
+    {
+        // Sleep for most of the wait then spin so short periods are still accurate
+        for (;;)
+        {
+            const auto remainingMs = juce::Time::highResolutionTicksToSeconds (nextCallbackTicks - juce::Time::getHighResolutionTicks()) * 1000.0;
+
+            if (remainingMs <= 0.0)
+                break;
+
+            if (remainingMs > 2.0)
+                juce::Thread::sleep ((int) remainingMs - 1);
+        }
+
+        const auto startTicks = juce::Time::getHighResolutionTicks();
+        callback();
+        const auto endTicks = juce::Time::getHighResolutionTicks();
+
+        results.timings.add (juce::Time::highResolutionTicksToSeconds (endTicks - startTicks));
+
+        if (endTicks - startTicks > deadlineTicks)
+            ++results.numMissedDeadlines;
+
+        // Like a device that drops a buffer, start again from now after an overrun
+        nextCallbackTicks = juce::jmax (nextCallbackTicks + periodTicks, endTicks);
+    }
+
+    return results;
+}
+
+//==============================================================================
+ScopedAllocationDisabler::ScopedAllocationDisabler()    { getAllocatorInterceptor().disableAllocations(); }
+ScopedAllocationDisabler::~ScopedAllocationDisabler()   { getAllocatorInterceptor().enableAllocations(); }
+
+//==============================================================================
+bool canCountPageFaults() noexcept
+{
+   #if JUCE_LINUX || JUCE_MAC || JUCE_BSD
+    return true;
+   #else
+    return false;
+   #endif
+}
+
+PageFaultCount getPageFaultCount() noexcept
+{
+   #if JUCE_LINUX
+    const int who = RUSAGE_THREAD;
+   #elif JUCE_MAC || JUCE_BSD
+    const int who = RUSAGE_SELF;
+   #endif
+
+   #if JUCE_LINUX || JUCE_MAC || JUCE_BSD
+    struct rusage usage {};
+
+    if (getrusage (who, &usage) == 0)
+        return { (juce::int64) usage.ru_minflt, (juce::int64) usage.ru_majflt };
+   #endif
+
+    return {};
+}
+
+PageFaultMonitor::PageFaultMonitor (int numBlocksToMonitor, int numWarmUpBlocksToIgnore)
+    : faultsPerBlock ((size_t) juce::jmax (0, numBlocksToMonitor)),
+      numWarmUpBlocks (numWarmUpBlocksToIgnore)
+{
+}
+
+void PageFaultMonitor::blockStarted() noexcept
+{
+    blockStart = getPageFaultCount();
+}
 
-    if (! ai.isAllowedToAllocate())
-    {
-        ai.logAllocationViolation();
-        return false;
-    }
+void PageFaultMonitor::blockEnded() noexcept
+{
+    const auto faults = getPageFaultCount() - blockStart;
 
-    return true;
+    if (juce::isPositiveAndBelow (numBlocksDone, (int) faultsPerBlock.size()))
+        faultsPerBlock[(size_t) numBlocksDone++] = faults;
 }
 
-inline void violationError (const std::string& text)
+juce::int64 PageFaultMonitor::getNumFaultsAfterWarmUp() const noexcept
 {
-    switch (AllocatorInterceptor::getViolationBehaviour())
-    {
-        case AllocatorInterceptor::ViolationBehaviour::logToCerr:
-            std::cerr << text;
-            break;
-        case AllocatorInterceptor::ViolationBehaviour::throwException:
-            throw;
-            break;
-        case AllocatorInterceptor::ViolationBehaviour::none:
-        default:
-            break;
-    }
+    juce::int64 total = 0;
+
+    for (int i = numWarmUpBlocks; i < numBlocksDone; ++i)
+        total += faultsPerBlock[(size_t) i].getTotal();
+
+    return total;
 }
 
-inline bool throwIfRequiredAndReturnShouldLog()
+juce::String PageFaultMonitor::getDescription() const
 {
-    switch (AllocatorInterceptor::getViolationBehaviour())
-    {
-        case AllocatorInterceptor::ViolationBehaviour::logToCerr:
-            return true;
-        case AllocatorInterceptor::ViolationBehaviour::throwException:
-            throw std::bad_alloc();
-        case AllocatorInterceptor::ViolationBehaviour::none:
-        default:
-            break;
-    }
+    juce::StringArray blocks;
 
-    return false;
+    for (int i = 0; i < numBlocksDone; ++i)
+        blocks.add (juce::String (faultsPerBlock[(size_t) i].minorFaults) + "/" + juce::String (faultsPerBlock[(size_t) i].majorFaults));
+
+    return "Page faults per block (minor/major): " + blocks.joinIntoString (", ");
+}
+
+juce::Result lockProcessMemory()
+{
+   #if JUCE_LINUX || JUCE_MAC || JUCE_BSD
+    if (mlockall (MCL_CURRENT | MCL_FUTURE) == 0)
+        return juce::Result::ok();
+
+    return juce::Result::fail ("mlockall failed: " + juce::String (strerror (errno)));
+   #else
+    return juce::Result::fail ("Memory locking is not supported on this platform");
+   #endif
+}
+
+void unlockProcessMemory()
+{
+   #if JUCE_LINUX || JUCE_MAC || JUCE_BSD
+    munlockall();
+   #endif
 }
 
 //==============================================================================
-#if JUCE_CLANG
- #define ATTRIBUTE_USED __attribute__((used))
-#else
- #define ATTRIBUTE_USED
-#endif
+PerformanceCounters::Reading& PerformanceCounters::Reading::operator+= (const Reading& other) noexcept
+{
+    for (size_t i = 0; i < values.size(); ++i)
+        values[i] += other.values[i];
 
-ATTRIBUTE_USED void* operator new (std::size_t sz)
+    numReadings += other.numReadings;
+    numMultiplexed += other.numMultiplexed;
+    numSamples += other.numSamples;
+    return *this;
+}
+
+PerformanceCounters::PerformanceCounters()
 {
-    if (! logAllocationViolationIfNotAllowed())
-        if (throwIfRequiredAndReturnShouldLog())
-            std::cerr << "!!! WARNING: Illegal allocation of " << sz << " bytes\n";
+    fds.fill (-1);
+    readIndexes.fill (-1);
 
-    return std::malloc (sz);
+   #if JUCE_LINUX
+    struct CounterType
+    {
+        juce::uint32 type;
+        juce::uint64 config;
+    };
+
+    const CounterType types[numCounters] =
+    {
+        { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+        { PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+        { PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16) },
+        { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES },
+        { PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES }
+    };
+
+    for (int i = 0; i < numCounters; ++i)
+    {
+        perf_event_attr attr {};
+        attr.size = sizeof (attr);
+        attr.type = types[i].type;
+        attr.config = types[i].config;
+        attr.disabled = i == cycles ? 1 : 0;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+        // The cycle counter leads the group so all the counters are started and stopped together
+        const int fd = (int) syscall (__NR_perf_event_open, &attr, 0, -1, fds[(size_t) cycles], 0);
+
+        if (fd < 0)
+        {
+            if (i == cycles)
+            {
+                unavailableReason = "perf_event_open failed: " + juce::String (strerror (errno))
+                                      + " (check /proc/sys/kernel/perf_event_paranoid)";
+                return;
+            }
+
+            continue;
+        }
+
+        fds[(size_t) i] = fd;
+        readIndexes[(size_t) i] = numOpen++;
+    }
+   #else
+    unavailableReason = "Performance counters are only supported on Linux";
+   #endif
 }
 
-ATTRIBUTE_USED void* operator new[] (std::size_t sz)
+PerformanceCounters::~PerformanceCounters()
 {
-    if (! logAllocationViolationIfNotAllowed())
-        if (throwIfRequiredAndReturnShouldLog())
-            std::cerr << "!!! WARNING: Illegal array allocation of " << sz << " bytes\n";
+   #if JUCE_LINUX
+    for (auto fd : fds)
+        if (fd >= 0)
+            close (fd);
+   #endif
+}
 
-    return std::malloc (sz);
+bool PerformanceCounters::isAvailable() const noexcept
+{
+    return isAvailable (cycles);
 }
 
-ATTRIBUTE_USED void operator delete (void* ptr) noexcept
+bool PerformanceCounters::isAvailable (Counter counter) const noexcept
 {
-    if (! logAllocationViolationIfNotAllowed())
-        if (throwIfRequiredAndReturnShouldLog())
-            std::cerr << "!!! WARNING: Illegal deletion\n";
+    return fds[(size_t) counter] >= 0;
+}
 
-    std::free (ptr);
+juce::String PerformanceCounters::getUnavailableReason() const
+{
+    return unavailableReason;
 }
 
-ATTRIBUTE_USED void operator delete[] (void* ptr) noexcept
+void PerformanceCounters::start() noexcept
 {
-    if (! logAllocationViolationIfNotAllowed())
-        if (throwIfRequiredAndReturnShouldLog())
-            std::cerr << "!!! WARNING: Illegal array deletion\n";
+   #if JUCE_LINUX
+    if (! isAvailable())
+        return;
 
-    std::free (ptr);
+    ioctl (fds[(size_t) cycles], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ioctl (fds[(size_t) cycles], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+   #endif
 }
 
-#if JUCE_CXX14_IS_AVAILABLE
-void operator delete (void* ptr, size_t) noexcept
+PerformanceCounters::Reading PerformanceCounters::stop (int numSamples) noexcept
 {
-    if (! logAllocationViolationIfNotAllowed())
-        if (throwIfRequiredAndReturnShouldLog())
-            std::cerr << "!!! WARNING: Illegal deletion\n";
+    Reading reading;
 
-    std::free (ptr);
+   #if JUCE_LINUX
+    if (! isAvailable())
+        return reading;
+
+    ioctl (fds[(size_t) cycles], PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+
+    // Group read format: nr, time_enabled, time_running, values[nr]
+    juce::uint64 data[3 + numCounters] {};
+
+    if (read (fds[(size_t) cycles], data, sizeof (data)) <= 0 || data[2] == 0)
+        return reading;
+
+    // If the group only ran for part of the time it was enabled, scale the counts up to estimate the full totals
+    const auto timeEnabled = data[1], timeRunning = data[2];
+    const bool wasMultiplexed = timeRunning < timeEnabled;
+    const auto scale = wasMultiplexed ? (double) timeEnabled / (double) timeRunning : 1.0;
+
+    for (size_t i = 0; i < reading.values.size(); ++i)
+        if (const auto index = readIndexes[i]; index >= 0 && (juce::uint64) index < data[0])
+            reading.values[i] = (juce::int64) ((double) data[3 + index] * scale);
+
+    reading.numReadings = 1;
+    reading.numMultiplexed = wasMultiplexed ? 1 : 0;
+    reading.numSamples = numSamples;
+   #endif
+
+    return reading;
 }
 
-void operator delete[] (void* ptr, size_t) noexcept
+juce::String PerformanceCounters::getDescription (const Reading& total, int numChannels) const
 {
-    if (! logAllocationViolationIfNotAllowed())
-        if (throwIfRequiredAndReturnShouldLog())
-            std::cerr << "!!! WARNING: Illegal array deletion\n";
+    if (total.numReadings == 0 || total.values[(size_t) cycles] == 0)
+        return "Performance counters: no readings";
 
-    std::free (ptr);
+    // Only the samples processed whilst a reading succeeded are counted
+    const auto numSampleChannels = (double) juce::jmax ((juce::int64) 1, total.numSamples * juce::jmax (1, numChannels));
+    const auto perBlock = [&total] (Counter c) { return juce::String ((double) total.values[(size_t) c] / total.numReadings, 1); };
+
+    juce::StringArray items;
+    items.add ("cycles/sample/channel: " + juce::String ((double) total.values[(size_t) cycles] / numSampleChannels, 2));
+
+    if (isAvailable (instructions))
+        items.add ("IPC: " + juce::String ((double) total.values[(size_t) instructions] / (double) total.values[(size_t) cycles], 2));
+
+    items.add ("cycles/block: " + perBlock (cycles));
+
+    if (isAvailable (l1DataCacheMisses))
+        items.add ("L1D misses/block: " + perBlock (l1DataCacheMisses));
+
+    if (isAvailable (lastLevelCacheMisses))
+        items.add ("LLC misses/block: " + perBlock (lastLevelCacheMisses));
+
+    if (isAvailable (branchMisses))
+        items.add ("branch misses/block: " + perBlock (branchMisses));
+
+    if (total.numMultiplexed > 0)
+        items.add ("estimated from multiplexed counters in " + juce::String (total.numMultiplexed)
+                   + " of " + juce::String (total.numReadings) + " blocks");
+
+    return "Performance counters: " + items.joinIntoString (", ");
+}
+
+std::unique_ptr<PerformanceCounters> createPerformanceCountersIfEnabled (PluginTests& ut)
+{
+    if (! ut.getOptions().performanceCounters)
+        return {};
+
+    auto counters = std::make_unique<PerformanceCounters>();
+
+    if (counters->isAvailable())
+        return counters;
+
+    ut.logMessage ("INFO: Performance counters unavailable: " + counters->getUnavailableReason());
+    return {};
 }
-#endif
 
 //==============================================================================
-std::atomic<AllocatorInterceptor::ViolationBehaviour> AllocatorInterceptor::violationBehaviour (ViolationBehaviour::logToCerr);
+RealtimeThread::RealtimeThread (int priority, int cpuCore)
+    : juce::Thread ("pluginval audio thread"),
+      requestedPriority (priority),
+      requestedCpuCore (cpuCore)
+{
+    startThread (requestedPriority > 0 ? juce::Thread::Priority::highest : juce::Thread::Priority::normal);
+    startedEvent.wait();
+}
 
-void AllocatorInterceptor::setViolationBehaviour (ViolationBehaviour behaviour) noexcept
+RealtimeThread::~RealtimeThread()
 {
-    violationBehaviour.store (behaviour);
+    signalThreadShouldExit();
+    functionReadyEvent.signal();
+    stopThread (-1);
 }
 
-AllocatorInterceptor::ViolationBehaviour AllocatorInterceptor::getViolationBehaviour() noexcept
+void RealtimeThread::call (const std::function<void()>& fn)
 {
-    return violationBehaviour.load();
+    jassert (getCurrentThreadId() != getThreadId());
+
+    functionToCall = fn;
+    functionReadyEvent.signal();
+    functionDoneEvent.wait();
+    functionToCall = nullptr;
+
+    if (auto e = std::exchange (exception, nullptr))
+        std::rethrow_exception (e);
 }
 
-AllocatorInterceptor& getAllocatorInterceptor()
+juce::String RealtimeThread::getDescription() const
 {
-    thread_local AllocatorInterceptor ai;
-    return ai;
+    return description;
 }
 
-//==============================================================================
-ScopedAllocationDisabler::ScopedAllocationDisabler()    { getAllocatorInterceptor().disableAllocations(); }
-ScopedAllocationDisabler::~ScopedAllocationDisabler()   { getAllocatorInterceptor().enableAllocations(); }
+void RealtimeThread::configureScheduling()
+{
+    if (requestedPriority <= 0)
+    {
+        description = "normal priority";
+    }
+    else
+    {
+       #if JUCE_LINUX || JUCE_MAC || JUCE_BSD
+        sched_param param {};
+        param.sched_priority = juce::jlimit (sched_get_priority_min (SCHED_FIFO),
+                                             sched_get_priority_max (SCHED_FIFO),
+                                             requestedPriority);
+
+        if (const auto error = pthread_setschedparam (pthread_self(), SCHED_FIFO, &param); error == 0)
+            description = "SCHED_FIFO priority " + juce::String (param.sched_priority);
+        else
+            description = "highest normal priority (SCHED_FIFO unavailable: " + juce::String (strerror (error)) + ")";
+       #else
+        description = "highest normal priority (SCHED_FIFO unavailable on this platform)";
+       #endif
+    }
+
+    if (requestedCpuCore >= 0)
+    {
+        if (requestedCpuCore < 32 && requestedCpuCore < juce::SystemStats::getNumCpus())
+        {
+            setCurrentThreadAffinityMask ((juce::uint32) 1 << requestedCpuCore);
+            description << ", pinned to CPU " << requestedCpuCore;
+        }
+        else
+        {
+            description << ", not pinned (CPU " << requestedCpuCore << " unavailable)";
+        }
+    }
+}
+
+void RealtimeThread::run()
+{
+    configureScheduling();
+    startedEvent.signal();
+
+    for (;;)
+    {
+        functionReadyEvent.wait();
+
+        if (threadShouldExit())
+            break;
+
+        try
+        {
+            functionToCall();
+        }
+        catch (...)
+        {
+            exception = std::current_exception();
+        }
+
+        functionDoneEvent.signal();
+    }
+}
 
 //==============================================================================
 struct AllocatorInterceptorTests    : public juce::UnitTest,
@@ -230,6 +1498,61 @@ struct AllocatorInterceptorTests    : public juce::UnitTest,
             expectGreaterThan (getAllocatorInterceptor().getAndClearNumAllocationViolations(), 0);
         }
 
+        beginTest ("Ensure violations are added to the log");
+        {
+            AllocatorInterceptor::setViolationBehaviour (AllocatorInterceptor::ViolationBehaviour::logToCerr);
+            auto& log = AllocationViolationLog::getInstance();
+            AllocationViolation violation;
+
+            while (log.pop (violation))
+            {}
+
+            {
+                ScopedAllocationDisabler sad;
+                std::vector<int> ints (42);
+            }
+
+            int numViolations = 0;
+            bool foundAllocation = false;
+
+            while (log.pop (violation))
+            {
+                ++numViolations;
+                expect (violation.threadID == juce::Thread::getCurrentThreadId());
+                expectEquals (violation.blockIndex, allocatorInterceptor.getBlockIndex());
+
+                if (violation.type == AllocationViolation::Type::allocation && violation.size == sizeof (int) * 42)
+                    foundAllocation = true;
+            }
+
+            expect (foundAllocation);
+            expectEquals (numViolations, allocatorInterceptor.getAndClearNumAllocationViolations());
+            expect (allocatorInterceptor.getAndClearAllocationViolation());
+            expectEquals (log.getAndClearNumDropped(), 0);
+            AllocatorInterceptor::setViolationBehaviour (AllocatorInterceptor::ViolationBehaviour::none);
+        }
+
+        beginTest ("Ensure the buffer pool doesn't allocate once reserved");
+        {
+            ProcessingBufferPool pool;
+            pool.reserve (4, 1024);
+
+            {
+                ScopedAllocationDisabler sad;
+
+                for (auto size : { 1024, 32, 512, 1 })
+                {
+                    auto& ab = pool.getAudioBuffer (size % 3 + 2, size);
+                    auto& mb = pool.getMidiBuffer();
+                    mb.addEvent (juce::MidiMessage::noteOn (1, 60, 0.5f), 0);
+                    ab.setSample (0, size - 1, 1.0f);
+                }
+            }
+
+            expect (! allocatorInterceptor.getAndClearAllocationViolation());
+            expectEquals (allocatorInterceptor.getAndClearNumAllocationViolations(), 0);
+        }
+
         beginTest ("Ensure allocations are thrown");
         {
             AllocatorInterceptor::setViolationBehaviour (AllocatorInterceptor::ViolationBehaviour::throwException);
@@ -253,3 +1576,157 @@ private:
 };
 
 static AllocatorInterceptorTests allocatorInterceptorTests;
+
+//==============================================================================
+struct BufferAnalysisTests  : public juce::UnitTest
+{
+    BufferAnalysisTests()
+        : juce::UnitTest ("BufferAnalysisTests", "pluginval")
+    {
+    }
+
+    void runTest() override
+    {
+        beginTest ("Silence");
+        {
+            juce::AudioBuffer<float> ab (2, 37);
+            ab.clear();
+            const auto analysis = analyseBuffer (ab);
+
+            expect (analysis.isValid());
+            expectEquals (analysis.peak, 0.0f);
+            expectEquals (analysis.rms, 0.0f);
+            expectEquals (analysis.dc, 0.0f);
+        }
+
+        beginTest ("Levels");
+        {
+            juce::AudioBuffer<float> ab (2, 101);
+
+            for (int c = 0; c < ab.getNumChannels(); ++c)
+                for (int s = 0; s < ab.getNumSamples(); ++s)
+                    ab.setSample (c, s, (s % 2 == 0) ? 0.75f : -0.25f);
+
+            ab.setSample (1, 99, -0.9f);
+            const auto analysis = analyseBuffer (ab);
+
+            expect (analysis.isValid());
+            expectEquals (analysis.peak, 0.9f);
+            expectWithinAbsoluteError (analysis.dc, 0.2517f, 1.0e-4f);
+            expectWithinAbsoluteError (analysis.rms, 0.5645f, 1.0e-4f);
+        }
+
+        beginTest ("Classification");
+        {
+            juce::AudioBuffer<float> ab (3, 67);
+            ab.clear();
+
+            ab.setSample (0, 0, std::numeric_limits<float>::quiet_NaN());
+            ab.setSample (2, 66, -std::numeric_limits<float>::quiet_NaN());
+            ab.setSample (1, 8, std::numeric_limits<float>::infinity());
+            ab.setSample (1, 9, -std::numeric_limits<float>::infinity());
+            ab.setSample (1, 65, std::numeric_limits<float>::infinity());
+            ab.setSample (2, 3, std::numeric_limits<float>::denorm_min());
+            ab.setSample (0, 64, 0.5f);
+            ab.setSample (0, 1, -0.0f);
+
+            const auto analysis = analyseBuffer (ab);
+
+            expect (! analysis.isValid());
+            expectEquals (analysis.numNaNs, 2);
+            expectEquals (analysis.numInfs, 3);
+            expectEquals (analysis.numSubnormals, 1);
+            expectEquals (analysis.peak, 0.5f);
+        }
+    }
+};
+
+static BufferAnalysisTests bufferAnalysisTests;
+
+//==============================================================================
+struct NoiseGeneratorTests  : public juce::UnitTest
+{
+    NoiseGeneratorTests()
+        : juce::UnitTest ("NoiseGeneratorTests", "pluginval")
+    {
+    }
+
+    void runTest() override
+    {
+        beginTest ("Noise is in range and reproducible from the seed");
+        {
+            std::vector<float> a (1003), b (1003), c (1003);
+            NoiseGenerator (1234).fill (a.data(), (int) a.size());
+            NoiseGenerator (1234).fill (b.data(), (int) b.size());
+            NoiseGenerator (4321).fill (c.data(), (int) c.size());
+
+            expect (a == b);
+            expect (a != c);
+
+            for (auto s : a)
+                expect (s >= -1.0f && s < 1.0f);
+        }
+
+        beginTest ("Noise bank fills every channel differently");
+        {
+            juce::Random r (42);
+            NoiseBank noise (r, 4096);
+            juce::AudioBuffer<float> ab (2, 3000);
+
+            for (int i = 0; i < 4; ++i)
+            {
+                noise.fill (ab);
+                const auto analysis = analyseBuffer (ab);
+
+                expect (analysis.isValid());
+                expectGreaterThan (analysis.rms, 0.5f);
+                expect (! std::equal (ab.getReadPointer (0), ab.getReadPointer (0) + ab.getNumSamples(), ab.getReadPointer (1)));
+            }
+        }
+    }
+};
+
+static NoiseGeneratorTests noiseGeneratorTests;
+
+
+//==============================================================================
+struct LinearFitTests   : public juce::UnitTest
+{
+    LinearFitTests()
+        : juce::UnitTest ("LinearFitTests", "pluginval")
+    {
+    }
+
+    void runTest() override
+    {
+        const std::vector<double> x { 1.0, 2.0, 4.0, 8.0, 16.0, 1024.0 };
+        std::vector<double> y;
+
+        for (auto v : x)
+            y.push_back (5.0 + 0.25 * v);
+
+        for (auto weightByInverseY : { false, true })
+        {
+            beginTest (juce::String ("Exact fit ") + (weightByInverseY ? "with" : "without") + " relative weighting");
+            const auto fit = fitLine (x, y, weightByInverseY);
+
+            expectWithinAbsoluteError (fit.intercept, 5.0, 1.0e-9);
+            expectWithinAbsoluteError (fit.slope, 0.25, 1.0e-9);
+            expectWithinAbsoluteError (fit.getValue (100.0), 30.0, 1.0e-9);
+        }
+
+        beginTest ("Relative weighting favours small values");
+        {
+            // Add the same absolute error to the largest point
+            auto noisyY = y;
+            noisyY.back() += 50.0;
+
+            const auto unweighted = fitLine (x, noisyY, false);
+            const auto weighted = fitLine (x, noisyY, true);
+
+            expectLessThan (std::abs (weighted.intercept - 5.0), std::abs (unweighted.intercept - 5.0));
+        }
+    }
+};
+
+static LinearFitTests linearFitTests;
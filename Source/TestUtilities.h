@@ -16,6 +16,8 @@
 
 #include "juce_audio_processors/juce_audio_processors.h"
 
+struct PluginTests;
+
 //==============================================================================
 struct StopwatchTimer
 {
@@ -39,6 +41,33 @@ private:
     juce::uint32 startTime;
 };
 
+//==============================================================================
+/** Collects the durations of repeated calls and summarises them as percentiles.
+    Reserve space up front if adding from a timed loop so it doesn't allocate.
+*/
+class TimingStatistics
+{
+public:
+    TimingStatistics() = default;
+
+    void reserve (int numTimings)               { timings.reserve ((size_t) numTimings); }
+    void add (double seconds)                   { timings.push_back (seconds); }
+    void clear() noexcept                       { timings.clear(); }
+
+    int getNumTimings() const noexcept          { return (int) timings.size(); }
+    double getMean() const noexcept;
+    double getMax() const noexcept;
+
+    /** Returns the nearest-rank percentile, where percentile is in the range [0, 100]. */
+    double getPercentile (double percentile) const;
+
+    /** Returns the mean, median, 99th percentile and max in microseconds. */
+    juce::String getDescription() const;
+
+private:
+    std::vector<double> timings;
+};
+
 
 //==============================================================================
 /** Returns the set of automatable parameters excluding the bypass parameter. */
@@ -53,6 +82,38 @@ static inline juce::Array<juce::AudioProcessorParameter*> getNonBypassAutomatabl
     return parameters;
 }
 
+//==============================================================================
+/** Audio and MIDI buffers allocated once for the largest channel count and block
+    size a test run will use. Tests take correctly sized buffers from this rather
+    than constructing new ones for each configuration, so the harness doesn't
+    allocate on the threads being timed or checked for allocations.
+*/
+class ProcessingBufferPool
+{
+public:
+    static constexpr int defaultMidiBufferBytes = 16384;
+
+    ProcessingBufferPool() = default;
+
+    /** Grows the pool if it is smaller than the given sizes.
+        This allocates so call it before processing starts.
+    */
+    void reserve (int maxNumChannels, int maxBlockSize, int midiBufferBytes = defaultMidiBufferBytes);
+
+    /** Returns the pool's audio buffer set to the given size and cleared.
+        This only allocates if the size is larger than has been reserved.
+    */
+    juce::AudioBuffer<float>& getAudioBuffer (int numChannels, int numSamples);
+
+    /** Returns the pool's MIDI buffer, cleared but keeping its capacity. */
+    juce::MidiBuffer& getMidiBuffer();
+
+private:
+    juce::AudioBuffer<float> audioBuffer;
+    juce::MidiBuffer midiBuffer;
+    int numChannelsReserved = 0, blockSizeReserved = 0, midiBytesReserved = 0;
+};
+
 //==============================================================================
 template<typename UnaryFunction>
 void iterateAudioBuffer (juce::AudioBuffer<float>& ab, UnaryFunction fn)
@@ -64,53 +125,186 @@ void iterateAudioBuffer (juce::AudioBuffer<float>& ab, UnaryFunction fn)
             fn (sampleData[c][s]);
 }
 
-static inline void fillNoise (juce::AudioBuffer<float>& ab) noexcept
+//==============================================================================
+/** A straight line fitted to some measurements by fitLine. */
+struct LinearFit
 {
-    juce::Random r;
-    juce::ScopedNoDenormals noDenormals;
+    double intercept = 0.0;
+    double slope = 0.0;
 
-    auto sampleData = ab.getArrayOfWritePointers();
+    double getValue (double x) const noexcept   { return intercept + slope * x; }
+};
 
-    for (int c = ab.getNumChannels(); --c >= 0;)
-        for (int s = ab.getNumSamples(); --s >= 0;)
-            sampleData[c][s] = r.nextFloat() * 2.0f - 1.0f;
-}
+/** Fits y = intercept + slope * x by least squares. If weightByInverseY is true,
+    each point's error is taken relative to its y value so that small values, such
+    as the timings of small blocks, influence the fit as much as large ones.
+*/
+LinearFit fitLine (const std::vector<double>& x, const std::vector<double>& y, bool weightByInverseY);
 
-static inline int countNaNs (juce::AudioBuffer<float>& ab) noexcept
+//==============================================================================
+/** A seedable xoshiro128+ generator that runs several independent streams
+    side by side so that filling a buffer vectorises.
+*/
+class NoiseGenerator
 {
-    int count = 0;
-    iterateAudioBuffer (ab, [&count] (float s)
-                            {
-                                if (std::isnan (s))
-                                    ++count;
-                            });
+public:
+    explicit NoiseGenerator (juce::int64 seed) noexcept;
 
-    return count;
-}
+    /** Fills the destination with uniform noise in the range [-1, 1). */
+    void fill (float* dest, int numSamples) noexcept;
+
+private:
+    static constexpr int numLanes = 8;
+    uint32_t s0[numLanes], s1[numLanes], s2[numLanes], s3[numLanes];
+
+    void generate (float* dest) noexcept;
+};
 
-static inline int countInfs (juce::AudioBuffer<float>& ab) noexcept
+//==============================================================================
+/** A block of noise generated up front that tests copy from, so generating
+    the stimulus doesn't add to the time spent around processBlock.
+    Seed it from the test's Random so the stimulus is reproducible from the
+    --random-seed option.
+*/
+class NoiseBank
 {
-    int count = 0;
-    iterateAudioBuffer (ab, [&count] (float s)
-    {
-        if (std::isinf (s))
-            ++count;
-    });
+public:
+    static constexpr int defaultNumSamples = 1 << 16;
+
+    explicit NoiseBank (juce::Random&, int numSamples = defaultNumSamples);
+
+    /** Copies the next section of noise to every channel of the buffer.
+        Each channel and call reads from a different offset in the bank.
+    */
+    void fill (juce::AudioBuffer<float>&) noexcept;
+
+    /** Copies the next section of noise to the destination. */
+    void fill (float* dest, int numSamples) noexcept;
+
+private:
+    std::vector<float> samples;
+    int readPosition = 0;
+};
 
-    return count;
+/** Fills every channel with freshly generated, unseeded noise.
+    This is slower than copying from a NoiseBank so keep it out of timed loops.
+*/
+static inline void fillNoise (juce::AudioBuffer<float>& ab) noexcept
+{
+    NoiseGenerator generator (juce::Random().nextInt64());
+
+    for (int ch = 0; ch < ab.getNumChannels(); ++ch)
+        generator.fill (ab.getWritePointer (ch), ab.getNumSamples());
 }
 
-static inline int countSubnormals (juce::AudioBuffer<float>& ab) noexcept
+//==============================================================================
+/** The result of a single pass over a buffer by analyseBuffer. */
+struct BufferAnalysis
+{
+    int numNaNs = 0;
+    int numInfs = 0;
+    int numSubnormals = 0;
+
+    float peak = 0.0f;  /**< Absolute peak of the finite samples. */
+    float rms = 0.0f;   /**< RMS of the finite samples. */
+    float dc = 0.0f;    /**< Mean of the finite samples. */
+
+    /** Returns true if there are no NaNs, Infs or subnormals. */
+    bool isValid() const noexcept       { return numNaNs == 0 && numInfs == 0 && numSubnormals == 0; }
+
+    /** Returns a one-line summary of the levels e.g. for logging. */
+    juce::String getDescription() const;
+};
+
+/** Classifies every sample of a buffer as NaN, Inf or subnormal from its
+    exponent bits and measures the peak, RMS and DC of the finite samples,
+    all in one vectorisable pass.
+*/
+BufferAnalysis analyseBuffer (const juce::AudioBuffer<float>&) noexcept;
+
+/** Expects the buffer to contain no NaNs, Infs or subnormals. */
+void expectValidBuffer (juce::UnitTest&, const BufferAnalysis&);
+
+/** Shorthands for a single count from analyseBuffer. Call analyseBuffer once
+    instead when more than one of these is needed.
+*/
+static inline int countNaNs (const juce::AudioBuffer<float>& ab) noexcept          { return analyseBuffer (ab).numNaNs; }
+static inline int countInfs (const juce::AudioBuffer<float>& ab) noexcept          { return analyseBuffer (ab).numInfs; }
+static inline int countSubnormals (const juce::AudioBuffer<float>& ab) noexcept    { return analyseBuffer (ab).numSubnormals; }
+
+//==============================================================================
+/** A set of precomputed stimulus signals for exercising the code paths that
+    uniform noise doesn't e.g. denormal tails, clipping and oversampling.
+    Each signal is small enough for the whole library to stay cache resident
+    so copying from it barely registers in timed loops.
+*/
+class StimulusLibrary
 {
-    int count = 0;
-    iterateAudioBuffer (ab, [&count] (float s)
+public:
+    enum Type
     {
-        if (s != 0.0f && std::fpclassify (s) == FP_SUBNORMAL)
-            ++count;
-    });
+        whiteNoise,
+        silence,
+        silenceToSignal,    /**< Silence for the first half, then full-level noise. */
+        fullScaleDC,
+        impulses,           /**< Single full-scale samples at a prime interval. */
+        nyquistSweep,       /**< A sine sweep between 0.4 and 0.4995 of the sample rate. */
+        interSamplePeaks,   /**< A full-scale fs/4 sine whose true peak is 3 dB above its sample peak. */
+        numTypes
+    };
 
-    return count;
-}
+    static constexpr int defaultNumSamples = 1 << 13;
+
+    explicit StimulusLibrary (juce::Random&, int numSamples = defaultNumSamples);
+
+    /** Returns a short, human readable name for the stimulus. */
+    static juce::String getName (Type);
+
+    /** Copies the next section of the stimulus to every channel of the buffer.
+        Apart from white noise, every channel receives the same signal and
+        successive calls continue where the previous one left off.
+    */
+    void fill (Type, juce::AudioBuffer<float>&) noexcept;
+
+private:
+    NoiseBank noise;
+    std::array<std::vector<float>, numTypes> signals;
+    std::array<int, numTypes> readPositions {};
+};
+
+/** Accumulates the timing and output validity of the blocks processed with a stimulus. */
+struct StimulusResults
+{
+    TimingStatistics timing;
+    int numBlocks = 0, numNaNs = 0, numInfs = 0, numSubnormals = 0;
+    float peak = 0.0f;
+
+    void add (double seconds, const BufferAnalysis&);
+
+    /** Returns the timing and output summary on a single line. */
+    juce::String getDescription() const;
+};
+
+//==============================================================================
+/** Simulates a busy session, where other plugins run between each callback, by
+    writing to every cache line of a buffer larger than the CPU's caches.
+    Call evict() just before processBlock to time it with cold caches.
+*/
+class CacheEvictor
+{
+public:
+    explicit CacheEvictor (size_t numBytes);
+
+    /** Returns the number of bytes written by each call to evict(). */
+    size_t getSize() const noexcept         { return buffer.size(); }
+
+    /** Touches every cache line of the buffer, pushing anything else out of the caches. */
+    void evict() noexcept;
+
+private:
+    std::vector<unsigned char> buffer;
+    unsigned char counter = 0;
+};
 
 static inline void addNoteOn (juce::MidiBuffer& mb, int channel, int noteNumber, int sample)
 {
@@ -122,6 +316,58 @@ static inline void addNoteOff (juce::MidiBuffer& mb, int channel, int noteNumber
     mb.addEvent (juce::MidiMessage::noteOff (channel, noteNumber, 0.5f), sample);
 }
 
+/** Calls processBlock and returns the time it took in seconds. */
+static inline double timeProcessBlock (juce::AudioProcessor& processor, juce::AudioBuffer<float>& ab, juce::MidiBuffer& mb)
+{
+    const auto startTicks = juce::Time::getHighResolutionTicks();
+    processor.processBlock (ab, mb);
+
+    return juce::Time::highResolutionTicksToSeconds (juce::Time::getHighResolutionTicks() - startTicks);
+}
+
+/** Calls processBlock with allocations disabled and returns the time it took in
+    seconds. The number of allocations the plugin made is added to numAllocations.
+*/
+double timeProcessBlockWithoutAllocating (juce::AudioPluginInstance&, juce::AudioBuffer<float>&,
+                                          juce::MidiBuffer&, int& numAllocations);
+
+/** Fails the test if there were any allocations above strictness level 8,
+    otherwise logs a warning.
+*/
+void checkAllocations (PluginTests&, int numAllocations, const juce::String& whilst);
+
+/** Returns the number of blocks that make up the given duration of audio,
+    bounded so that tiny block sizes don't make a benchmark take too long.
+*/
+static inline int getNumBenchmarkBlocks (double sampleRate, int blockSize, double secondsOfAudio = 0.5)
+{
+    const auto numBlocks = juce::roundToInt (secondsOfAudio * sampleRate / juce::jmax (1, blockSize));
+    return juce::jlimit (16, 4096, numBlocks);
+}
+
+/** The timings recorded by simulateAudioCallbacks. */
+struct CallbackDeadlineResults
+{
+    TimingStatistics timings;
+    int numMissedDeadlines = 0;
+};
+
+/** Calls a function once per callback period for the given number of callbacks,
+    as an audio device would, recording how long each call takes and how many
+    overran the deadline. The deadline is a proportion of the period so a safety
+    margin can be left for the host. Waiting for each period rather than running
+    back to back means caches and CPU frequency behave as they do in a live host.
+*/
+CallbackDeadlineResults simulateAudioCallbacks (const std::function<void()>& callback,
+                                                double periodSeconds, int numCallbacks,
+                                                double deadlineProportion = 1.0);
+
+/** Returns the time taken to process a block as a percentage of the block's duration. */
+static inline double getRealtimePercentage (double secondsTaken, double sampleRate, int blockSize)
+{
+    return secondsTaken * 100.0 * sampleRate / juce::jmax (1, blockSize);
+}
+
 static inline float getParametersSum (juce::AudioPluginInstance& instance)
 {
     float value = 0.0f;
@@ -332,6 +578,281 @@ struct ScopedBusesLayout
 };
 
 
+//==============================================================================
+/** The number of page faults taken, split in to those that were serviced
+    without I/O (minor) and those that required I/O (major).
+*/
+struct PageFaultCount
+{
+    juce::int64 minorFaults = 0, majorFaults = 0;
+
+    juce::int64 getTotal() const noexcept    { return minorFaults + majorFaults; }
+
+    PageFaultCount operator- (PageFaultCount other) const noexcept
+    {
+        return { minorFaults - other.minorFaults, majorFaults - other.majorFaults };
+    }
+};
+
+/** Returns true if page faults can be counted on this platform. */
+bool canCountPageFaults() noexcept;
+
+/** Returns the number of page faults taken so far.
+    On Linux this uses RUSAGE_THREAD so only counts faults on the calling thread,
+    on other POSIX platforms it counts faults for the whole process.
+*/
+PageFaultCount getPageFaultCount() noexcept;
+
+/**
+    Records the page faults taken during each of a number of processed blocks.
+    This will only allocate on construction so is safe to use around processBlock.
+*/
+struct PageFaultMonitor
+{
+    /** Creates a monitor for a number of blocks, the first numWarmUpBlocks of
+        which are expected to fault in memory that hasn't been touched yet.
+    */
+    PageFaultMonitor (int numBlocksToMonitor, int numWarmUpBlocks);
+
+    /** Call this immediately before processBlock. */
+    void blockStarted() noexcept;
+
+    /** Call this immediately after processBlock. */
+    void blockEnded() noexcept;
+
+    /** Returns the total number of faults recorded after the warm-up blocks. */
+    juce::int64 getNumFaultsAfterWarmUp() const noexcept;
+
+    /** Returns the faults per block in the order they were processed. */
+    juce::String getDescription() const;
+
+private:
+    std::vector<PageFaultCount> faultsPerBlock;
+    const int numWarmUpBlocks;
+    int numBlocksDone = 0;
+    PageFaultCount blockStart;
+};
+
+/** Locks all the current and future pages of the process in to RAM as some
+    hosts do with mlockall.
+*/
+juce::Result lockProcessMemory();
+
+/** Unlocks any memory previously locked with lockProcessMemory. */
+void unlockProcessMemory();
+
+
+//==============================================================================
+/**
+    A group of hardware performance counters for the thread that creates it.
+
+    On Linux this uses perf_event_open to count cycles, instructions, L1 data
+    cache misses, last level cache misses and branch misses. Counters the CPU or
+    kernel don't support are skipped and if none can be opened (e.g. due to
+    perf_event_paranoid or on other platforms) isAvailable() will return false.
+*/
+class PerformanceCounters
+{
+public:
+    enum Counter
+    {
+        cycles,
+        instructions,
+        l1DataCacheMisses,
+        lastLevelCacheMisses,
+        branchMisses,
+        numCounters
+    };
+
+    /** A set of counter values, unavailable counters are always 0.
+        If the kernel had to multiplex the counters, the values are scaled up to
+        estimate the full count and numMultiplexed is incremented.
+    */
+    struct Reading
+    {
+        std::array<juce::int64, numCounters> values {};
+        int numReadings = 0;
+        int numMultiplexed = 0;
+        juce::int64 numSamples = 0;     /**< The number of samples processed in the successful readings. */
+
+        Reading& operator+= (const Reading&) noexcept;
+    };
+
+    /** Opens the counters for the calling thread. */
+    PerformanceCounters();
+
+    /** Destructor. */
+    ~PerformanceCounters();
+
+    /** Returns true if at least the cycle counter could be opened. */
+    bool isAvailable() const noexcept;
+
+    /** Returns true if a specific counter could be opened. */
+    bool isAvailable (Counter) const noexcept;
+
+    /** If the counters aren't available, returns the reason why. */
+    juce::String getUnavailableReason() const;
+
+    /** Resets and starts the counters. Call this immediately before processBlock. */
+    void start() noexcept;
+
+    /** Stops the counters and returns their values since start() was called,
+        along with the number of samples processed in that time.
+        If the counters couldn't be scheduled by the kernel, the reading will
+        have a numReadings of 0.
+    */
+    Reading stop (int numSamples) noexcept;
+
+    /** Returns a description of some accumulated readings, including the cycles
+        per sample per channel and instructions per cycle.
+    */
+    juce::String getDescription (const Reading& total, int numChannels) const;
+
+private:
+    std::array<int, numCounters> fds;
+    std::array<int, numCounters> readIndexes;
+    int numOpen = 0;
+    juce::String unavailableReason;
+
+    JUCE_DECLARE_NON_COPYABLE (PerformanceCounters)
+};
+
+/** Creates a set of PerformanceCounters for the calling thread if they have been
+    enabled in the test options. If they aren't available the reason is logged
+    and nullptr is returned.
+*/
+std::unique_ptr<PerformanceCounters> createPerformanceCountersIfEnabled (PluginTests&);
+
+//==============================================================================
+/**
+    A thread which runs functions with real-time scheduling, as hosts do for
+    their audio callbacks.
+
+    On POSIX platforms this tries to use SCHED_FIFO with the requested priority.
+    If that isn't possible (usually due to missing permissions) the thread falls
+    back to the highest normal priority instead. A priority of 0 uses normal
+    scheduling, for running alongside tests that haven't opted in to real-time
+    threads. Use getDescription() to find out which mode is being used.
+*/
+class RealtimeThread   : private juce::Thread
+{
+public:
+    /** Creates and starts the thread.
+        @param priority     The SCHED_FIFO priority to use, clamped to the range the system supports, or 0 for normal scheduling
+        @param cpuCore      The index of a CPU core to pin the thread to, or -1 to not set an affinity
+    */
+    RealtimeThread (int priority, int cpuCore);
+
+    /** Destructor. */
+    ~RealtimeThread() override;
+
+    /** Calls a function on the thread, blocking until it has completed.
+        Any exception thrown by the function will be rethrown on the calling thread.
+    */
+    void call (const std::function<void()>&);
+
+    /** Returns a description of the scheduling mode being used. */
+    juce::String getDescription() const;
+
+private:
+    const int requestedPriority, requestedCpuCore;
+    juce::WaitableEvent startedEvent, functionReadyEvent, functionDoneEvent;
+    std::function<void()> functionToCall;
+    std::exception_ptr exception;
+    juce::String description;
+
+    void configureScheduling();
+    void run() override;
+};
+
+//==============================================================================
+/**
+    Measures how responsive the message thread is by posting a heartbeat message
+    at a fixed interval and recording how long each one takes to be dispatched.
+    A plugin that blocks the message thread will show up as a long stall.
+*/
+class MessageThreadWatchdog  : private juce::Thread
+{
+public:
+    /** Starts posting heartbeats. */
+    explicit MessageThreadWatchdog (int heartbeatIntervalMs = 10);
+
+    /** Destructor. */
+    ~MessageThreadWatchdog() override;
+
+    /** Clears the recorded latencies, e.g. before starting a new test. */
+    void reset();
+
+    static constexpr int numHistogramBuckets = 11;
+
+    /** The latencies recorded since the last reset. */
+    struct Results
+    {
+        double worstStallMs = 0.0;
+        int numHeartbeats = 0;
+        std::array<int, numHistogramBuckets> histogram {};
+
+        /** Returns the upper bound of a histogram bucket in ms, the last bucket is unbounded. */
+        static double getBucketLimitMs (int bucketIndex);
+
+        /** Returns a description of the worst stall and the latency histogram. */
+        juce::String getDescription() const;
+    };
+
+    /** Returns the latencies recorded since the last reset.
+        If includePendingHeartbeat is true, this includes the time any heartbeat still
+        waiting to be dispatched has been pending for. Pass false when the caller is
+        itself holding the message thread, so only heartbeats it let through count.
+    */
+    Results getResults (bool includePendingHeartbeat = true) const;
+
+private:
+    struct State;
+    const std::shared_ptr<State> state;
+    const int intervalMs;
+
+    void run() override;
+};
+
+//==============================================================================
+/**
+    Runs synthetic background load on a set of threads to emulate a machine
+    running many other processes, e.g. a render node. The threads run until
+    this is destroyed.
+*/
+class ContentionStressor
+{
+public:
+    enum class Workload
+    {
+        cpu,                /**< Integer arithmetic that keeps the cores busy. */
+        memoryBandwidth,    /**< Copies between large buffers to saturate the memory bus. */
+        lockContention      /**< Repeatedly takes a lock shared by all the threads. */
+    };
+
+    /** Returns a short, human readable name for the workload. */
+    static juce::String getName (Workload);
+
+    /** Starts the threads.
+        @param workload             The type of load to generate
+        @param numThreads           The number of threads to run it on
+        @param intensityPercent     The percentage of each 10 ms period the threads are busy for
+    */
+    ContentionStressor (Workload workload, int numThreads, int intensityPercent);
+
+    /** Stops the threads. */
+    ~ContentionStressor();
+
+private:
+    struct StressThread;
+    juce::OwnedArray<StressThread> threads;
+    std::mutex sharedLock;
+    std::atomic<juce::uint64> sharedCounter { 0 };
+
+    JUCE_DECLARE_NON_COPYABLE (ContentionStressor)
+};
+
+
 //==============================================================================
 /**
     Used to enable intercepting of allocations using new, new[], delete and
@@ -343,6 +864,7 @@ struct AllocatorInterceptor
 
     void disableAllocations()
     {
+        ++blockIndex;
         allocationsAllowed.store (false);
     }
 
@@ -356,6 +878,14 @@ struct AllocatorInterceptor
         return allocationsAllowed.load();
     }
 
+    /** Returns the number of times allocations have been disabled on this thread.
+        This is used to identify the block in which a violation occurred.
+    */
+    int getBlockIndex() const noexcept
+    {
+        return blockIndex.load();
+    }
+
     //==============================================================================
     void logAllocationViolation()
     {
@@ -391,6 +921,7 @@ struct AllocatorInterceptor
 
 private:
     std::atomic<bool> allocationsAllowed { true };
+    std::atomic<int> blockIndex { 0 };
     std::atomic<int> numAllocationViolations { 0 };
     std::atomic<bool> violationOccured { false };
     static std::atomic<ViolationBehaviour> violationBehaviour;
@@ -400,6 +931,107 @@ private:
 /** Returns an AllocatorInterceptor for the current thread. */
 AllocatorInterceptor& getAllocatorInterceptor();
 
+//==============================================================================
+/** A record of an allocation or deletion made whilst allocations were disabled. */
+struct AllocationViolation
+{
+    enum class Type
+    {
+        allocation,
+        arrayAllocation,
+        deletion,
+        arrayDeletion
+    };
+
+    Type type = Type::allocation;
+    std::size_t size = 0;                           /**< The number of bytes allocated, 0 if unknown. */
+    juce::int64 timeTicks = 0;                      /**< The high resolution ticks at which the violation occurred. */
+    juce::Thread::ThreadID threadID = nullptr;      /**< The thread the violation occurred on. */
+    int testIndex = -1;                             /**< The index of the test running, see AllocationViolationLog::setCurrentTest. */
+    int blockIndex = 0;                             /**< The AllocatorInterceptor::getBlockIndex of the offending thread. */
+};
+
+//==============================================================================
+/**
+    A fixed size, lock-free queue of AllocationViolations.
+
+    Violations are pushed from the offending thread without allocating, locking
+    or doing any I/O so they don't distort any timing being measured. They are
+    then formatted and logged by an AllocationViolationLogger on another thread.
+
+    Any number of threads can push violations but only one thread should pop them.
+*/
+class AllocationViolationLog
+{
+public:
+    /** Returns the global log. */
+    static AllocationViolationLog& getInstance();
+
+    /** Adds a violation to the log. If the log is full this returns false and
+        the violation is counted as dropped.
+    */
+    bool push (const AllocationViolation&) noexcept;
+
+    /** Removes the oldest violation from the log, returning false if it was empty. */
+    bool pop (AllocationViolation&) noexcept;
+
+    /** Returns the number of violations that couldn't be added since the last call. */
+    int getAndClearNumDropped() noexcept;
+
+    //==============================================================================
+    /** Sets the name of the test that subsequent violations will be attributed to.
+        This isn't real-time safe so shouldn't be called whilst allocations are disabled.
+    */
+    void setCurrentTest (const juce::String& testName);
+
+    /** Returns the index of the test set with setCurrentTest, or -1 if none has been set. */
+    int getCurrentTestIndex() const noexcept;
+
+    /** Returns the name of a test from a violation's testIndex. */
+    juce::String getTestName (int testIndex) const;
+
+private:
+    static constexpr std::size_t capacity = 4096;
+
+    struct Slot
+    {
+        std::atomic<std::size_t> sequence { 0 };
+        AllocationViolation violation;
+    };
+
+    AllocationViolationLog();
+
+    std::array<Slot, capacity> slots;
+    alignas (64) std::atomic<std::size_t> writePosition { 0 };
+    alignas (64) std::atomic<std::size_t> readPosition { 0 };
+    std::atomic<int> numDropped { 0 }, currentTestIndex { -1 };
+
+    juce::CriticalSection testNamesLock;
+    juce::StringArray testNames;
+};
+
+//==============================================================================
+/**
+    Drains the AllocationViolationLog on a background thread, writing a
+    description of each violation to std::cerr.
+    Create one of these for the duration in which violations should be reported.
+*/
+class AllocationViolationLogger  : private juce::Thread
+{
+public:
+    /** Starts the logging thread. */
+    AllocationViolationLogger();
+
+    /** Stops the thread, logging any remaining violations. */
+    ~AllocationViolationLogger() override;
+
+private:
+    const juce::int64 startTicks;
+
+    void logPendingViolations();
+    void run() override;
+};
+
 //==============================================================================
 /**
     Helper class to log allocations on the current thread.
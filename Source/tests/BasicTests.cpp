@@ -143,9 +143,11 @@ struct EditorWhilstProcessingTest   : public PluginTest
             callPrepareToPlayOnMessageThreadIfVST3 (instance, sampleRates[0], blockSizes[0]);
 
             const int numChannelsRequired = juce::jmax (instance.getTotalNumInputChannels(), instance.getTotalNumOutputChannels());
-            juce::AudioBuffer<float> ab (numChannelsRequired, instance.getBlockSize());
-            juce::MidiBuffer mb;
+            auto& ab = ut.getBufferPool().getAudioBuffer (numChannelsRequired, instance.getBlockSize());
+            auto& mb = ut.getBufferPool().getMidiBuffer();
 
+            auto r = ut.getRandom();
+            NoiseBank noise (r);
 
             juce::WaitableEvent threadStartedEvent;
             std::atomic<bool> shouldProcess { true };
@@ -155,7 +157,7 @@ struct EditorWhilstProcessingTest   : public PluginTest
                                              {
                                                  while (shouldProcess)
                                                  {
-                                                     fillNoise (ab);
+                                                     noise.fill (ab);
                                                      instance.processBlock (ab, mb);
                                                      mb.clear();
 
@@ -181,7 +183,8 @@ static EditorWhilstProcessingTest editorWhilstProcessingTest;
 struct AudioProcessingTest  : public PluginTest
 {
     AudioProcessingTest()
-        : PluginTest ("Audio processing", 3)
+        : PluginTest ("Audio processing", 3,
+                      { Requirements::Thread::audioThread, Requirements::GUI::noGUI })
     {
     }
 
@@ -196,8 +199,10 @@ struct AudioProcessingTest  : public PluginTest
         jassert (sampleRates.size()>0 && blockSizes.size()>0);
         callPrepareToPlayOnMessageThreadIfVST3 (instance, sampleRates[0], blockSizes[0]);
 
-        const int numBlocks = 10;
+        const int numBlocks = 10, numWarmUpBlocks = 2;
         auto r = ut.getRandom();
+        NoiseBank noise (r);
+        auto counters = createPerformanceCountersIfEnabled (ut);
 
         for (auto sr : sampleRates)
         {
@@ -213,8 +218,8 @@ struct AudioProcessingTest  : public PluginTest
                 callPrepareToPlayOnMessageThreadIfVST3 (instance, sr, bs);
 
                 const int numChannelsRequired = juce::jmax (instance.getTotalNumInputChannels(), instance.getTotalNumOutputChannels());
-                juce::AudioBuffer<float> ab (numChannelsRequired, bs);
-                juce::MidiBuffer mb;
+                auto& ab = ut.getBufferPool().getAudioBuffer (numChannelsRequired, bs);
+                auto& mb = ut.getBufferPool().getMidiBuffer();
 
                 // Add a random note on if the plugin is a synth
                 const int noteChannel = r.nextInt ({ 1, 17 });
@@ -223,19 +228,48 @@ struct AudioProcessingTest  : public PluginTest
                 if (isPluginInstrument)
                     addNoteOn (mb, noteChannel, noteNumber, juce::jmin (10, bs));
 
+                PageFaultMonitor pageFaults (numBlocks, numWarmUpBlocks);
+                PerformanceCounters::Reading counterTotal;
+                BufferAnalysis outputAnalysis;
+
                 for (int i = 0; i < numBlocks; ++i)
                 {
                     // Add note off in last block if plugin is a synth
                     if (isPluginInstrument && i == (numBlocks - 1))
                         addNoteOff (mb, noteChannel, noteNumber, 0);
 
-                    fillNoise (ab);
+                    noise.fill (ab);
+
+                    pageFaults.blockStarted();
+
+                    if (counters != nullptr)
+                        counters->start();
+
                     instance.processBlock (ab, mb);
+
+                    if (counters != nullptr)
+                        counterTotal += counters->stop (ab.getNumSamples());
+
+                    pageFaults.blockEnded();
+
                     mb.clear();
 
-                    ut.expectEquals (countNaNs (ab), 0, "NaNs found in buffer");
-                    ut.expectEquals (countInfs (ab), 0, "Infs found in buffer");
-                    ut.expectEquals (countSubnormals (ab), 0, "Subnormals found in buffer");
+                    outputAnalysis = analyseBuffer (ab);
+                    expectValidBuffer (ut, outputAnalysis);
+                }
+
+                ut.logVerboseMessage ("Output levels: " + outputAnalysis.getDescription());
+
+                if (counters != nullptr)
+                    ut.logMessage (counters->getDescription (counterTotal, ab.getNumChannels()));
+
+                if (canCountPageFaults())
+                {
+                    ut.logVerboseMessage (pageFaults.getDescription());
+
+                    if (const auto numFaults = pageFaults.getNumFaultsAfterWarmUp(); numFaults > 0)
+                        ut.logMessage ("!!! WARNING: " + juce::String (numFaults) + " page faults occurred after the first "
+                                       + juce::String (numWarmUpBlocks) + " blocks");
                 }
             }
         }
@@ -258,7 +292,8 @@ static AudioProcessingTest audioProcessingTest;
 struct NonReleasingAudioProcessingTest  : public PluginTest
 {
     NonReleasingAudioProcessingTest()
-        : PluginTest ("Non-releasing audio processing", 6)
+        : PluginTest ("Non-releasing audio processing", 6,
+                      { Requirements::Thread::audioThread, Requirements::GUI::noGUI })
     {
     }
 
@@ -271,6 +306,92 @@ struct NonReleasingAudioProcessingTest  : public PluginTest
 static NonReleasingAudioProcessingTest nonReleasingAudioProcessingTest;
 
 
+//==============================================================================
+/**
+    Processes each of the signals in the StimulusLibrary in turn and reports the
+    processing time and output validity for each one.
+*/
+struct AudioProcessingStimuliTest   : public PluginTest
+{
+    AudioProcessingStimuliTest()
+        : PluginTest ("Audio processing stimuli", 5,
+                      { Requirements::Thread::audioThread, Requirements::GUI::noGUI })
+    {
+    }
+
+    void runTest (PluginTests& ut, juce::AudioPluginInstance& instance) override
+    {
+        const bool subnormalsAreErrors = ut.getOptions().strictnessLevel > 5;
+        const bool isPluginInstrument = instance.getPluginDescription().isInstrument;
+
+        const std::vector<double>& sampleRates = ut.getOptions().sampleRates;
+        const std::vector<int>& blockSizes = ut.getOptions().blockSizes;
+
+        jassert (sampleRates.size() > 0 && blockSizes.size() > 0);
+
+        const int numBlocksPerStimulus = 8;
+        auto r = ut.getRandom();
+        StimulusLibrary stimuli (r);
+
+        for (auto sr : sampleRates)
+        {
+            for (auto bs : blockSizes)
+            {
+                ut.logMessage (juce::String ("Testing with sample rate [SR] and block size [BS]")
+                                   .replace ("SR",juce::String (sr, 0), false)
+                                   .replace ("BS",juce::String (bs), false));
+
+                callReleaseResourcesOnMessageThreadIfVST3 (instance);
+                callPrepareToPlayOnMessageThreadIfVST3 (instance, sr, bs);
+
+                const int numChannelsRequired = juce::jmax (instance.getTotalNumInputChannels(), instance.getTotalNumOutputChannels());
+                auto& ab = ut.getBufferPool().getAudioBuffer (numChannelsRequired, bs);
+                auto& mb = ut.getBufferPool().getMidiBuffer();
+
+                for (int type = 0; type < StimulusLibrary::numTypes; ++type)
+                {
+                    const auto stimulus = static_cast<StimulusLibrary::Type> (type);
+                    StimulusResults results;
+                    results.timing.reserve (numBlocksPerStimulus);
+
+                    const int noteChannel = r.nextInt ({ 1, 17 });
+                    const int noteNumber = r.nextInt (128);
+
+                    for (int i = 0; i < numBlocksPerStimulus; ++i)
+                    {
+                        if (isPluginInstrument && i == 0)
+                            addNoteOn (mb, noteChannel, noteNumber, juce::jmin (10, bs - 1));
+                        else if (isPluginInstrument && i == (numBlocksPerStimulus - 1))
+                            addNoteOff (mb, noteChannel, noteNumber, 0);
+
+                        stimuli.fill (stimulus, ab);
+
+                        const auto seconds = timeProcessBlock (instance, ab, mb);
+                        mb.clear();
+                        results.add (seconds, analyseBuffer (ab));
+                    }
+
+                    const auto name = StimulusLibrary::getName (stimulus);
+                    ut.logMessage (name + ": " + results.getDescription());
+
+                    ut.expectEquals (results.numNaNs, 0, "NaNs found in buffer processing " + name);
+                    ut.expectEquals (results.numInfs, 0, "Infs found in buffer processing " + name);
+
+                    if (subnormalsAreErrors)
+                        ut.expectEquals (results.numSubnormals, 0, "Subnormals found in buffer processing " + name);
+                    else if (results.numSubnormals > 0)
+                        ut.logMessage ("!!! WARNING: " + juce::String (results.numSubnormals) + " subnormals found in buffer processing " + name);
+                }
+
+                ut.resetTimeout();
+            }
+        }
+    }
+};
+
+static AudioProcessingStimuliTest audioProcessingStimuliTest;
+
+
 //==============================================================================
 struct PluginStateTest  : public PluginTest
 {
@@ -346,7 +467,8 @@ static PluginStateTestRestoration pluginStateTestRestoration;
 struct AutomationTest  : public PluginTest
 {
     AutomationTest()
-        : PluginTest ("Automation", 3)
+        : PluginTest ("Automation", 3,
+                      { Requirements::Thread::audioThread, Requirements::GUI::noGUI })
     {
     }
 
@@ -363,6 +485,7 @@ struct AutomationTest  : public PluginTest
         callPrepareToPlayOnMessageThreadIfVST3 (instance, sampleRates[0], blockSizes[0]);
 
         auto r = ut.getRandom();
+        NoiseBank noise (r);
 
         for (auto sr : sampleRates)
         {
@@ -379,8 +502,8 @@ struct AutomationTest  : public PluginTest
 
                 int numSamplesDone = 0;
                 const int numChannelsRequired = juce::jmax (instance.getTotalNumInputChannels(), instance.getTotalNumOutputChannels());
-                juce::AudioBuffer<float> ab (numChannelsRequired, bs);
-                juce::MidiBuffer mb;
+                auto& ab = ut.getBufferPool().getAudioBuffer (numChannelsRequired, bs);
+                auto& mb = ut.getBufferPool().getMidiBuffer();
 
                 // Add a random note on if the plugin is a synth
                 const int noteChannel = r.nextInt ({ 1, 17 });
@@ -393,7 +516,7 @@ struct AutomationTest  : public PluginTest
                 {
                     // Set random parameter values
                     {
-                        auto parameters = getNonBypassAutomatableParameters (instance);
+                        const auto& parameters = ut.getAutomatableParameters();
 
                         for (int i = 0; i < juce::jmin (10, parameters.size()); ++i)
                         {
@@ -413,7 +536,7 @@ struct AutomationTest  : public PluginTest
                                                   ab.getNumChannels(),
                                                   numSamplesDone,
                                                   numSamplesThisTime);
-                    fillNoise (subBuffer);
+                    noise.fill (subBuffer);
                     instance.processBlock (subBuffer, mb);
                     numSamplesDone += numSamplesThisTime;
 
@@ -423,15 +546,14 @@ struct AutomationTest  : public PluginTest
                         break;
                 }
 
-                ut.expectEquals (countNaNs (ab), 0, "NaNs found in buffer");
-                ut.expectEquals (countInfs (ab), 0, "Infs found in buffer");
-
-                const int subnormals = countSubnormals (ab);
+                const auto analysis = analyseBuffer (ab);
+                ut.expectEquals (analysis.numNaNs, 0, "NaNs found in buffer");
+                ut.expectEquals (analysis.numInfs, 0, "Infs found in buffer");
 
                 if (subnormalsAreErrors)
-                    ut.expectEquals (countInfs (ab), 0, "Subnormals found in buffer");
-                else if (subnormals > 0)
-                    ut.logMessage ("!!! WARNING: " + juce::String (countSubnormals (ab)) + " subnormals found in buffer");
+                    ut.expectEquals (analysis.numSubnormals, 0, "Subnormals found in buffer");
+                else if (analysis.numSubnormals > 0)
+                    ut.logMessage ("!!! WARNING: " + juce::String (analysis.numSubnormals) + " subnormals found in buffer");
             }
         }
     }
@@ -609,7 +731,8 @@ static BackgroundThreadStateTest backgroundThreadStateTest;
 struct ParameterThreadSafetyTest    : public PluginTest
 {
     ParameterThreadSafetyTest()
-        : PluginTest ("Parameter thread safety", 7)
+        : PluginTest ("Parameter thread safety", 7,
+                      { Requirements::Thread::audioThread, Requirements::GUI::noGUI })
     {
     }
 
@@ -617,7 +740,8 @@ struct ParameterThreadSafetyTest    : public PluginTest
     {
         juce::WaitableEvent startWaiter, endWaiter;
         auto r = ut.getRandom();
-        auto parameters = getNonBypassAutomatableParameters (instance);
+        NoiseBank noise (r);
+        const auto& parameters = ut.getAutomatableParameters();
         const bool isPluginInstrument = instance.getPluginDescription().isInstrument;
         const int numBlocks = 500;
 
@@ -638,8 +762,8 @@ struct ParameterThreadSafetyTest    : public PluginTest
         callPrepareToPlayOnMessageThreadIfVST3 (instance, 44100.0, blockSize);
 
         const int numChannelsRequired = juce::jmax (instance.getTotalNumInputChannels(), instance.getTotalNumOutputChannels());
-        juce::AudioBuffer<float> ab (numChannelsRequired, blockSize);
-        juce::MidiBuffer mb;
+        auto& ab = ut.getBufferPool().getAudioBuffer (numChannelsRequired, blockSize);
+        auto& mb = ut.getBufferPool().getMidiBuffer();
 
         // Add a random note on if the plugin is a synth
         const int noteChannel = r.nextInt ({ 1, 17 });
@@ -659,7 +783,7 @@ struct ParameterThreadSafetyTest    : public PluginTest
             for (auto param : parameters)
                 param->setValue (r.nextFloat());
 
-            fillNoise (ab);
+            noise.fill (ab);
             instance.processBlock (ab, mb);
             mb.clear();
         }
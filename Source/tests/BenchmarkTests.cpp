@@ -0,0 +1,1198 @@
+/*==============================================================================
+
+  Copyright 2018 by Tracktion Corporation.
+  For more information visit www.tracktion.com
+
+   You may also use this code under the terms of the GPL v3 (see
+   www.gnu.org/licenses).
+
+   pluginval IS PROVIDED "AS IS" WITHOUT ANY WARRANTY, AND ALL WARRANTIES, WHETHER
+   EXPRESSED OR IMPLIED, INCLUDING MERCHANTABILITY AND FITNESS FOR PURPOSE, ARE
+   DISCLAIMED.
+
+ ==============================================================================*/
+
+#include "../PluginTests.h"
+#include "../TestUtilities.h"
+
+//==============================================================================
+/**
+    Compares the cost of processing silence, once a signal has decayed past the
+    plugin's reported tail, with the cost of processing an active signal.
+    Plugins that do just as much work on silence waste CPU in large sessions
+    where most instances are idle most of the time.
+*/
+struct IdleEfficiencyTest   : public PluginTest
+{
+    IdleEfficiencyTest()
+        : PluginTest ("Idle efficiency", 7,
+                      { Requirements::Thread::audioThread, Requirements::GUI::noGUI })
+    {
+    }
+
+    void runTest (PluginTests& ut, juce::AudioPluginInstance& instance) override
+    {
+        const bool isPluginInstrument = instance.getPluginDescription().isInstrument;
+
+        const std::vector<double>& sampleRates = ut.getOptions().sampleRates;
+        const std::vector<int>& blockSizes = ut.getOptions().blockSizes;
+
+        jassert (sampleRates.size() > 0 && blockSizes.size() > 0);
+
+        auto r = ut.getRandom();
+        StimulusLibrary stimuli (r);
+
+        for (auto sr : sampleRates)
+        {
+            for (auto bs : blockSizes)
+            {
+                ut.logMessage (juce::String ("Testing with sample rate [SR] and block size [BS]")
+                                   .replace ("SR",juce::String (sr, 0), false)
+                                   .replace ("BS",juce::String (bs), false));
+
+                callReleaseResourcesOnMessageThreadIfVST3 (instance);
+                callPrepareToPlayOnMessageThreadIfVST3 (instance, sr, bs);
+
+                const int numChannelsRequired = juce::jmax (instance.getTotalNumInputChannels(), instance.getTotalNumOutputChannels());
+                auto& ab = ut.getBufferPool().getAudioBuffer (numChannelsRequired, bs);
+                auto& mb = ut.getBufferPool().getMidiBuffer();
+
+                const int numBlocks = getNumBenchmarkBlocks (sr, bs);
+                const int noteChannel = r.nextInt ({ 1, 17 });
+                const int noteNumber = r.nextInt (128);
+
+                // Process an active signal, holding a note for the duration if the plugin is a synth
+                TimingStatistics activeTimings;
+                activeTimings.reserve (numBlocks);
+
+                for (int i = 0; i < numBlocks; ++i)
+                {
+                    if (isPluginInstrument && i == 0)
+                        addNoteOn (mb, noteChannel, noteNumber, 0);
+
+                    stimuli.fill (StimulusLibrary::whiteNoise, ab);
+                    activeTimings.add (timeProcessBlock (instance, ab, mb));
+                    mb.clear();
+                }
+
+                if (isPluginInstrument)
+                    addNoteOff (mb, noteChannel, noteNumber, 0);
+
+                // Let the signal decay past the reported tail
+                const double maxDecaySeconds = 5.0;
+                const auto tailSeconds = instance.getTailLengthSeconds();
+                const bool tailIsBounded = std::isfinite (tailSeconds) && tailSeconds <= maxDecaySeconds;
+                const auto decaySeconds = (tailIsBounded ? juce::jmax (0.0, tailSeconds) : maxDecaySeconds) + 0.1;
+
+                if (! tailIsBounded)
+                    ut.logMessage ("INFO: Reported tail of " + juce::String (tailSeconds, 2) + "s is too long to wait for, decaying for "
+                                   + juce::String (maxDecaySeconds, 1) + "s instead");
+
+                for (auto numDecaySamples = (juce::int64) (decaySeconds * sr); numDecaySamples > 0; numDecaySamples -= bs)
+                {
+                    stimuli.fill (StimulusLibrary::silence, ab);
+                    instance.processBlock (ab, mb);
+                    mb.clear();
+                }
+
+                ut.resetTimeout();
+
+                // Process silence
+                TimingStatistics idleTimings;
+                idleTimings.reserve (numBlocks);
+                float idlePeak = 0.0f;
+
+                for (int i = 0; i < numBlocks; ++i)
+                {
+                    stimuli.fill (StimulusLibrary::silence, ab);
+                    idleTimings.add (timeProcessBlock (instance, ab, mb));
+                    mb.clear();
+
+                    idlePeak = std::max (idlePeak, analyseBuffer (ab).peak);
+                }
+
+                logResults (ut, activeTimings, idleTimings, sr, bs);
+
+                if (tailIsBounded && juce::Decibels::gainToDecibels (idlePeak) > -100.0f)
+                    ut.logMessage ("!!! WARNING: Output peaks at " + juce::String (juce::Decibels::gainToDecibels (idlePeak), 1)
+                                   + " dB after the reported tail of " + juce::String (tailSeconds, 2) + "s");
+            }
+        }
+    }
+
+    static void logResults (PluginTests& ut, const TimingStatistics& active, const TimingStatistics& idle,
+                            double sampleRate, int blockSize)
+    {
+        const auto activeMedian = active.getPercentile (50.0);
+        const auto idleMedian = idle.getPercentile (50.0);
+        const auto idleRealtimePercentage = getRealtimePercentage (idleMedian, sampleRate, blockSize);
+
+        ut.logVerboseMessage ("Active: " + active.getDescription());
+        ut.logVerboseMessage ("Idle: " + idle.getDescription());
+
+        if (activeMedian <= 0.0)
+            return;
+
+        // A ratio close to 1 means the plugin does as much work on silence as on signal
+        ut.logMessage ("Idle efficiency ratio: " + juce::String (idleMedian / activeMedian, 2)
+                       + " (active: " + juce::String (getRealtimePercentage (activeMedian, sampleRate, blockSize), 2)
+                       + "% of real-time, idle: " + juce::String (idleRealtimePercentage, 2) + "% of real-time)");
+        ut.logMessage ("Estimated saving if a host skips processing after the tail: "
+                       + juce::String (idleRealtimePercentage, 2) + "% of a core per idle instance");
+    }
+};
+
+static IdleEfficiencyTest idleEfficiencyTest;
+
+
+//==============================================================================
+/**
+    Times processBlock at block sizes from 1 to 4096 and fits the cost to
+    fixed + perSample * numSamples. A large fixed cost per call is what makes
+    plugins expensive at the small block sizes used for low-latency monitoring.
+*/
+struct PerCallOverheadTest  : public PluginTest
+{
+    PerCallOverheadTest()
+        : PluginTest ("Per-call overhead", 7,
+                      { Requirements::Thread::audioThread, Requirements::GUI::noGUI })
+    {
+    }
+
+    void runTest (PluginTests& ut, juce::AudioPluginInstance& instance) override
+    {
+        jassert (ut.getOptions().sampleRates.size() > 0);
+        const double sampleRate = ut.getOptions().sampleRates[0];
+        const int maxBlockSize = 4096;
+
+        ut.logMessage (juce::String ("Preparing with sample rate [SR] and block size [BS]")
+                           .replace ("SR",juce::String (sampleRate, 0), false)
+                           .replace ("BS",juce::String (maxBlockSize), false));
+
+        callReleaseResourcesOnMessageThreadIfVST3 (instance);
+        callPrepareToPlayOnMessageThreadIfVST3 (instance, sampleRate, maxBlockSize);
+
+        const int numChannelsRequired = juce::jmax (instance.getTotalNumInputChannels(), instance.getTotalNumOutputChannels());
+        auto& ab = ut.getBufferPool().getAudioBuffer (numChannelsRequired, maxBlockSize);
+        auto& mb = ut.getBufferPool().getMidiBuffer();
+
+        auto r = ut.getRandom();
+        NoiseBank noise (r);
+        std::vector<double> blockSizes, medianTimes;
+
+        for (int blockSize = 1; blockSize <= maxBlockSize; blockSize *= 2)
+        {
+            // Process roughly the same number of samples at each size so the test time stays bounded
+            const int numBlocks = juce::jlimit (16, 8192, 65536 / blockSize);
+            const int numWarmUpBlocks = juce::jmax (2, numBlocks / 8);
+
+            TimingStatistics timings;
+            timings.reserve (numBlocks);
+
+            for (int i = 0; i < numWarmUpBlocks + numBlocks; ++i)
+            {
+                juce::AudioBuffer<float> subBuffer (ab.getArrayOfWritePointers(), ab.getNumChannels(), blockSize);
+                noise.fill (subBuffer);
+
+                const auto seconds = timeProcessBlock (instance, subBuffer, mb);
+                mb.clear();
+
+                if (i >= numWarmUpBlocks)
+                    timings.add (seconds);
+            }
+
+            const auto median = timings.getPercentile (50.0);
+            blockSizes.push_back (blockSize);
+            medianTimes.push_back (median);
+
+            ut.logVerboseMessage ("Block size " + juce::String (blockSize) + ": " + timings.getDescription()
+                                  + ", " + juce::String (median * 1.0e9 / blockSize, 1) + " ns per sample");
+            ut.resetTimeout();
+        }
+
+        logFit (ut, fitLine (blockSizes, medianTimes, true), sampleRate);
+    }
+
+    static void logFit (PluginTests& ut, LinearFit fit, double sampleRate)
+    {
+        const auto fixedCost = juce::jmax (0.0, fit.intercept);
+        const auto perSampleCost = juce::jmax (0.0, fit.slope);
+
+        ut.logMessage ("Fixed cost per call: " + juce::String (fixedCost * 1.0e6, 2) + " us");
+        ut.logMessage ("Cost per sample: " + juce::String (perSampleCost * 1.0e9, 2) + " ns ("
+                       + juce::String (perSampleCost * sampleRate * 100.0, 2) + "% of real-time)");
+
+        if (perSampleCost <= 0.0)
+        {
+            ut.logMessage ("INFO: Processing cost doesn't grow with block size, the fixed overhead dominates at every size");
+            return;
+        }
+
+        // overhead / (overhead + perSample * n) < 0.1  =>  n > 9 * overhead / perSample
+        const auto blockSizeForTenPercent = 9.0 * fixedCost / perSampleCost;
+        ut.logMessage ("Fixed overhead drops below 10% of the total cost at block sizes above "
+                       + juce::String (juce::roundToInt (std::ceil (blockSizeForTenPercent))) + " samples");
+    }
+};
+
+static PerCallOverheadTest perCallOverheadTest;
+
+
+//==============================================================================
+/**
+    Processes the same stimulus at sample rates from 44.1 to 384 kHz and
+    reports the cost per second of audio, and how that compares to scaling
+    linearly with the sample rate. Plugins that oversample to a fixed internal
+    rate show up as costing relatively more at low host rates.
+*/
+struct SampleRateScalingTest    : public PluginTest
+{
+    SampleRateScalingTest()
+        : PluginTest ("Sample rate scaling", 7,
+                      { Requirements::Thread::audioThread, Requirements::GUI::noGUI })
+    {
+    }
+
+    void runTest (PluginTests& ut, juce::AudioPluginInstance& instance) override
+    {
+        jassert (ut.getOptions().blockSizes.size() > 0);
+        const bool subnormalsAreErrors = ut.getOptions().strictnessLevel > 5;
+        const double referenceSampleRate = 44100.0;
+        const int referenceBlockSize = ut.getOptions().blockSizes[0];
+        const double secondsOfAudio = 0.25;
+
+        auto r = ut.getRandom();
+        StimulusLibrary stimuli (r);
+        double referenceCostPerSecond = 0.0;
+
+        ut.logMessage ("Block sizes are scaled with the sample rate so each block lasts as long as "
+                       + juce::String (referenceBlockSize) + " samples at 44.1 kHz");
+        ut.logMessage ("Sample rate, block size, cost per second of audio, % of real-time, relative to linear scaling");
+
+        for (auto sampleRate : { 44100.0, 48000.0, 88200.0, 96000.0, 176400.0, 192000.0, 384000.0 })
+        {
+            // Not all plugins support 384 kHz so only warn about problems there
+            const bool isOptionalRate = sampleRate > 192000.0;
+            const int blockSize = juce::jmax (1, juce::roundToInt (referenceBlockSize * sampleRate / referenceSampleRate));
+
+            callReleaseResourcesOnMessageThreadIfVST3 (instance);
+            callPrepareToPlayOnMessageThreadIfVST3 (instance, sampleRate, blockSize);
+
+            const int numChannelsRequired = juce::jmax (instance.getTotalNumInputChannels(), instance.getTotalNumOutputChannels());
+            auto& ab = ut.getBufferPool().getAudioBuffer (numChannelsRequired, blockSize);
+            auto& mb = ut.getBufferPool().getMidiBuffer();
+
+            const int numBlocks = getNumBenchmarkBlocks (sampleRate, blockSize, secondsOfAudio);
+            const int numWarmUpBlocks = juce::jmax (2, numBlocks / 8);
+            double totalSeconds = 0.0;
+            int numNaNs = 0, numInfs = 0, numSubnormals = 0;
+
+            for (int i = 0; i < numWarmUpBlocks + numBlocks; ++i)
+            {
+                stimuli.fill (StimulusLibrary::nyquistSweep, ab);
+                const auto seconds = timeProcessBlock (instance, ab, mb);
+                mb.clear();
+
+                const auto analysis = analyseBuffer (ab);
+                numNaNs += analysis.numNaNs;
+                numInfs += analysis.numInfs;
+                numSubnormals += analysis.numSubnormals;
+
+                if (i >= numWarmUpBlocks)
+                    totalSeconds += seconds;
+            }
+
+            ut.resetTimeout();
+
+            if (isOptionalRate && (numNaNs > 0 || numInfs > 0 || numSubnormals > 0))
+            {
+                ut.logMessage ("!!! WARNING: Invalid output at " + juce::String (sampleRate / 1000.0, 1)
+                               + " kHz, the plugin may not support this sample rate");
+                continue;
+            }
+
+            ut.expectEquals (numNaNs, 0, "NaNs found in buffer");
+            ut.expectEquals (numInfs, 0, "Infs found in buffer");
+
+            if (subnormalsAreErrors)
+                ut.expectEquals (numSubnormals, 0, "Subnormals found in buffer");
+            else if (numSubnormals > 0)
+                ut.logMessage ("!!! WARNING: " + juce::String (numSubnormals) + " subnormals found in buffer");
+
+            const auto audioSeconds = (double) numBlocks * blockSize / sampleRate;
+            const auto costPerSecond = totalSeconds / audioSeconds;
+
+            if (referenceCostPerSecond <= 0.0)
+                referenceCostPerSecond = costPerSecond;
+
+            const auto linearCost = referenceCostPerSecond * sampleRate / referenceSampleRate;
+
+            ut.logMessage (juce::String (sampleRate / 1000.0, 1) + " kHz, " + juce::String (blockSize) + ", "
+                           + juce::String (costPerSecond * 1.0e3, 2) + " ms, "
+                           + juce::String (costPerSecond * 100.0, 2) + "%, "
+                           + (linearCost > 0.0 ? juce::String (costPerSecond / linearCost, 2) + "x" : juce::String ("-")));
+        }
+    }
+};
+
+static SampleRateScalingTest sampleRateScalingTest;
+
+
+//==============================================================================
+/**
+    Runs a chain of plugin instances in series in a juce::AudioProcessorGraph,
+    as a host does on a track, and compares how long each instance takes in the
+    chain with how long it takes on its own. Instances compete for caches and
+    memory bandwidth with their neighbours so can run much slower in a session
+    than an isolated benchmark suggests.
+    This only runs if a chain length is set in the options.
+*/
+struct PluginChainTest  : public PluginTest
+{
+    PluginChainTest()
+        : PluginTest ("Plugin chain", 8,
+                      { Requirements::Thread::backgroundThread, Requirements::GUI::noGUI })
+    {
+    }
+
+    void runTest (PluginTests& ut, juce::AudioPluginInstance& instance) override
+    {
+        const int chainLength = ut.getOptions().chainLength;
+
+        if (chainLength < 2)
+        {
+            ut.logMessage ("INFO: Skipping plugin chain benchmark, set a chain length of 2 or more to run it");
+            return;
+        }
+
+        jassert (ut.getOptions().sampleRates.size() > 0 && ut.getOptions().blockSizes.size() > 0);
+        const double sampleRate = ut.getOptions().sampleRates[0];
+        const int blockSize = ut.getOptions().blockSizes[0];
+        const int numBlocks = getNumBenchmarkBlocks (sampleRate, blockSize);
+        const int numWarmUpBlocks = juce::jmax (2, numBlocks / 8);
+
+        ut.logMessage (juce::String ("Testing with sample rate [SR] and block size [BS]")
+                           .replace ("SR",juce::String (sampleRate, 0), false)
+                           .replace ("BS",juce::String (blockSize), false));
+
+        // The graph has to own its processors so the chain is made from new instances.
+        // This and the graph setup happen on this thread, only the processing runs on the audio thread.
+        auto processors = createChain (ut, instance, chainLength, sampleRate, blockSize, numWarmUpBlocks + numBlocks);
+
+        if (processors.size() < 2)
+        {
+            ut.logMessage ("!!! WARNING: Unable to create enough plugin instances to build a chain");
+            return;
+        }
+
+        auto r = ut.getRandom();
+        NoiseBank noise (r);
+        int numChannels = 1;
+
+        for (auto& p : processors)
+            numChannels = juce::jmax (numChannels, p->getTotalNumInputChannels(), p->getTotalNumOutputChannels());
+
+        auto& ab = ut.getBufferPool().getAudioBuffer (numChannels, blockSize);
+        auto& mb = ut.getBufferPool().getMidiBuffer();
+
+        // Time each instance on its own first
+        std::vector<double> isolatedMedians;
+        double totalIsolatedMedian = 0.0;
+
+        for (auto& p : processors)
+        {
+            auto& chainInstance = p->getInstance();
+            callPrepareToPlayOnMessageThreadIfVST3 (chainInstance, sampleRate, blockSize);
+
+            const int numInstanceChannels = juce::jmax (chainInstance.getTotalNumInputChannels(), chainInstance.getTotalNumOutputChannels());
+            juce::AudioBuffer<float> instanceBuffer (ab.getArrayOfWritePointers(), numInstanceChannels, blockSize);
+
+            TimingStatistics timings;
+            timings.reserve (numBlocks);
+            ut.callOnAudioThread ([&] { processBlocks (chainInstance, {}, noise, instanceBuffer, mb, numWarmUpBlocks, numBlocks, timings); });
+
+            isolatedMedians.push_back (timings.getPercentile (50.0));
+            totalIsolatedMedian += isolatedMedians.back();
+
+            callReleaseResourcesOnMessageThreadIfVST3 (chainInstance);
+            ut.resetTimeout();
+        }
+
+        // Then build the graph and time the whole chain
+        juce::Array<TimedProcessor*> nodes;
+
+        for (auto& p : processors)
+            nodes.add (p.get());
+
+        auto graph = createGraphOnMessageThread (std::move (processors), numChannels, sampleRate, blockSize);
+
+        TimingStatistics graphTimings;
+        graphTimings.reserve (numBlocks);
+        ut.callOnAudioThread ([&] { processBlocks (*graph, nodes, noise, ab, mb, numWarmUpBlocks, numBlocks, graphTimings); });
+        ut.resetTimeout();
+
+        const auto graphAnalysis = analyseBuffer (ab);
+        ut.expectEquals (graphAnalysis.numNaNs, 0, "NaNs found in chain output");
+        ut.expectEquals (graphAnalysis.numInfs, 0, "Infs found in chain output");
+
+        logResults (ut, nodes, isolatedMedians, totalIsolatedMedian, graphTimings, sampleRate, blockSize);
+
+        deleteGraphOnMessageThread (std::move (graph));
+    }
+
+    //==============================================================================
+    /** Forwards to a plugin instance, recording how long each processBlock call takes. */
+    class TimedProcessor  : public juce::AudioProcessor
+    {
+    public:
+        TimedProcessor (std::unique_ptr<juce::AudioPluginInstance> pluginInstance, int maxNumTimings)
+            : juce::AudioProcessor (getBusesProperties (*pluginInstance)),
+              instance (std::move (pluginInstance)),
+              numTimingsToReserve (maxNumTimings)
+        {
+            timings.reserve (numTimingsToReserve);
+        }
+
+        juce::AudioPluginInstance& getInstance()                { return *instance; }
+        const TimingStatistics& getTimings() const              { return timings; }
+
+        /** Call from the processing thread to discard any warm up timings. */
+        void clearTimings() noexcept                            { timings.clear(); }
+
+        const juce::String getName() const override             { return instance->getName(); }
+
+        void prepareToPlay (double sampleRate, int blockSize) override
+        {
+            instance->prepareToPlay (sampleRate, blockSize);
+            setLatencySamples (instance->getLatencySamples());
+        }
+
+        void releaseResources() override                        { instance->releaseResources(); }
+
+        void processBlock (juce::AudioBuffer<float>& ab, juce::MidiBuffer& mb) override
+        {
+            // Stop recording once the reserved space is used up so this never allocates
+            if (timings.getNumTimings() < numTimingsToReserve)
+                timings.add (timeProcessBlock (*instance, ab, mb));
+            else
+                instance->processBlock (ab, mb);
+        }
+
+        double getTailLengthSeconds() const override            { return instance->getTailLengthSeconds(); }
+        bool acceptsMidi() const override                       { return instance->acceptsMidi(); }
+        bool producesMidi() const override                      { return instance->producesMidi(); }
+        bool isMidiEffect() const override                      { return instance->isMidiEffect(); }
+
+        juce::AudioProcessorEditor* createEditor() override     { return nullptr; }
+        bool hasEditor() const override                         { return false; }
+
+        int getNumPrograms() override                           { return 1; }
+        int getCurrentProgram() override                        { return 0; }
+        void setCurrentProgram (int) override                   {}
+        const juce::String getProgramName (int) override        { return {}; }
+        void changeProgramName (int, const juce::String&) override {}
+
+        void getStateInformation (juce::MemoryBlock&) override  {}
+        void setStateInformation (const void*, int) override    {}
+
+    private:
+        std::unique_ptr<juce::AudioPluginInstance> instance;
+        const int numTimingsToReserve;
+        TimingStatistics timings;
+
+        /** Mirrors each of the instance's buses so the buffer passed on is laid out as it expects. */
+        static BusesProperties getBusesProperties (juce::AudioPluginInstance& p)
+        {
+            BusesProperties props;
+
+            for (auto isInput : { true, false })
+            {
+                for (int busIndex = 0; busIndex < p.getBusCount (isInput); ++busIndex)
+                {
+                    if (auto* bus = p.getBus (isInput, busIndex))
+                    {
+                        const auto& layout = bus->getCurrentLayout();
+                        const bool isEnabled = ! layout.isDisabled();
+                        props.addBus (isInput, bus->getName(), isEnabled ? layout : bus->getDefaultLayout(), isEnabled);
+                    }
+                }
+            }
+
+            return props;
+        }
+
+        JUCE_DECLARE_NON_COPYABLE (TimedProcessor)
+    };
+
+    /** Creates the instances for the chain, interleaving the tested plugin with any others given in the options. */
+    static std::vector<std::unique_ptr<TimedProcessor>> createChain (PluginTests& ut, juce::AudioPluginInstance& instance, int chainLength,
+                                                                     double sampleRate, int blockSize, int maxNumTimings)
+    {
+        juce::Array<juce::PluginDescription> descriptions;
+        descriptions.add (instance.getPluginDescription());
+
+        for (auto fileOrID : ut.getOptions().chainPlugins)
+        {
+            auto found = ut.findPluginDescriptions (fileOrID);
+
+            if (auto first = found.getFirst())
+                descriptions.add (*first);
+            else
+                ut.logMessage ("!!! WARNING: No plugins found for the chain in: " + fileOrID);
+        }
+
+        std::vector<std::unique_ptr<TimedProcessor>> processors;
+
+        for (int i = 0; i < chainLength; ++i)
+        {
+            const auto& pd = descriptions.getReference (i % descriptions.size());
+            juce::String errorMessage;
+
+            if (auto chainInstance = ut.createPluginInstance (pd, sampleRate, blockSize, errorMessage))
+            {
+                processors.push_back (std::make_unique<TimedProcessor> (std::move (chainInstance), maxNumTimings));
+            }
+            else
+            {
+                ut.logMessage ("!!! WARNING: Unable to create " + pd.name + " for the chain: " + errorMessage);
+                break;
+            }
+        }
+
+        ut.logMessage ("Chain: " + getChainDescription (processors));
+
+        return processors;
+    }
+
+    static juce::String getChainDescription (const std::vector<std::unique_ptr<TimedProcessor>>& processors)
+    {
+        juce::StringArray names;
+
+        for (auto& p : processors)
+            names.add (p->getName());
+
+        return names.joinIntoString (" -> ");
+    }
+
+    /** Connects the processors in series between the graph's inputs and outputs
+        and prepares it. This is done on the message thread as VST3s expect to be
+        prepared there.
+    */
+    static std::unique_ptr<juce::AudioProcessorGraph> createGraphOnMessageThread (std::vector<std::unique_ptr<TimedProcessor>> processors,
+                                                                                  int numChannels, double sampleRate, int blockSize)
+    {
+        using IOProcessor = juce::AudioProcessorGraph::AudioGraphIOProcessor;
+        auto graph = std::make_unique<juce::AudioProcessorGraph>();
+
+        juce::WaitableEvent waiter;
+        juce::MessageManager::callAsync ([&]
+                                   {
+                                       graph->setPlayConfigDetails (numChannels, numChannels, sampleRate, blockSize);
+
+                                       auto previous = graph->addNode (std::make_unique<IOProcessor> (IOProcessor::audioInputNode));
+                                       auto midiInput = graph->addNode (std::make_unique<IOProcessor> (IOProcessor::midiInputNode));
+
+                                       for (auto& p : processors)
+                                       {
+                                           auto node = graph->addNode (std::move (p));
+                                           connect (*graph, *previous, *node);
+
+                                           if (node->getProcessor()->acceptsMidi())
+                                               graph->addConnection ({ { midiInput->nodeID, juce::AudioProcessorGraph::midiChannelIndex },
+                                                                       { node->nodeID, juce::AudioProcessorGraph::midiChannelIndex } });
+
+                                           previous = node;
+                                       }
+
+                                       connect (*graph, *previous, *graph->addNode (std::make_unique<IOProcessor> (IOProcessor::audioOutputNode)));
+                                       graph->prepareToPlay (sampleRate, blockSize);
+                                       waiter.signal();
+                                   });
+        waiter.wait();
+
+        return graph;
+    }
+
+    static void connect (juce::AudioProcessorGraph& graph, juce::AudioProcessorGraph::Node& source, juce::AudioProcessorGraph::Node& destination)
+    {
+        const int numChannels = juce::jmin (source.getProcessor()->getTotalNumOutputChannels(),
+                                            destination.getProcessor()->getTotalNumInputChannels());
+
+        for (int channel = 0; channel < numChannels; ++channel)
+            graph.addConnection ({ { source.nodeID, channel }, { destination.nodeID, channel } });
+    }
+
+    static void deleteGraphOnMessageThread (std::unique_ptr<juce::AudioProcessorGraph> graph)
+    {
+        juce::WaitableEvent waiter;
+        juce::MessageManager::callAsync ([&]
+                                   {
+                                       graph->releaseResources();
+                                       graph.reset();
+                                       juce::Thread::sleep (150); // Pause a few ms to let the plugins clean up after themselves
+                                       waiter.signal();
+                                   });
+        waiter.wait();
+    }
+
+    /** Processes some warm up blocks followed by the timed ones, holding a note
+        throughout so any instruments in the chain produce a signal. The timings
+        of any nodes passed in are cleared once the warm up is done.
+    */
+    static void processBlocks (juce::AudioProcessor& processor, const juce::Array<TimedProcessor*>& nodes, NoiseBank& noise,
+                               juce::AudioBuffer<float>& ab, juce::MidiBuffer& mb,
+                               int numWarmUpBlocks, int numBlocks, TimingStatistics& timings)
+    {
+        for (int i = 0; i < numWarmUpBlocks + numBlocks; ++i)
+        {
+            if (i == 0)
+                addNoteOn (mb, 1, 60, 0);
+
+            if (i == numWarmUpBlocks)
+                for (auto node : nodes)
+                    node->clearTimings();
+
+            noise.fill (ab);
+            const auto seconds = timeProcessBlock (processor, ab, mb);
+            mb.clear();
+
+            if (i >= numWarmUpBlocks)
+                timings.add (seconds);
+        }
+
+        addNoteOff (mb, 1, 60, 0);
+        noise.fill (ab);
+        processor.processBlock (ab, mb);
+        mb.clear();
+    }
+
+    static void logResults (PluginTests& ut, const juce::Array<TimedProcessor*>& nodes,
+                            const std::vector<double>& isolatedMedians, double totalIsolatedMedian,
+                            const TimingStatistics& graphTimings, double sampleRate, int blockSize)
+    {
+        const auto graphMedian = graphTimings.getPercentile (50.0);
+
+        ut.logMessage ("Chain: " + graphTimings.getDescription() + ", "
+                       + juce::String (getRealtimePercentage (graphMedian, sampleRate, blockSize), 2) + "% of real-time");
+        ut.logMessage ("Sum of isolated instances: " + juce::String (totalIsolatedMedian * 1.0e6, 1) + " us median, "
+                       + juce::String (getRealtimePercentage (totalIsolatedMedian, sampleRate, blockSize), 2) + "% of real-time");
+
+        if (totalIsolatedMedian > 0.0)
+            ut.logMessage ("Chain overhead: " + juce::String (graphMedian / totalIsolatedMedian, 2) + "x the sum of isolated instances");
+
+        ut.logMessage ("Position, plugin, isolated median, in chain median, slowdown");
+
+        for (int i = 0; i < nodes.size(); ++i)
+        {
+            const auto isolated = isolatedMedians[(size_t) i];
+            const auto inChain = nodes.getUnchecked (i)->getTimings().getPercentile (50.0);
+            const auto slowdown = isolated > 0.0 ? inChain / isolated : 0.0;
+
+            ut.logMessage (juce::String (i + 1) + ", " + nodes.getUnchecked (i)->getName() + ", "
+                           + juce::String (isolated * 1.0e6, 1) + " us, "
+                           + juce::String (inChain * 1.0e6, 1) + " us, "
+                           + (slowdown > 0.0 ? juce::String (slowdown, 2) + "x" : juce::String ("-")));
+
+            if (slowdown > 2.0)
+                ut.logMessage ("!!! WARNING: Instance " + juce::String (i + 1) + " runs "
+                               + juce::String (slowdown, 1) + "x slower in the chain than on its own");
+        }
+    }
+};
+
+static PluginChainTest pluginChainTest;
+
+
+//==============================================================================
+/**
+    Times processBlock with the caches flushed before every call, as they would
+    be in a busy session where many other plugins run between callbacks, and
+    compares it with the usual warm cache timings. Plugins with large working
+    sets, e.g. big tables or convolution kernels, become much more expensive
+    under load than a tight benchmark loop suggests.
+    This only runs if a cache eviction size is set in the options.
+*/
+struct ColdCacheTest    : public PluginTest
+{
+    ColdCacheTest()
+        : PluginTest ("Cold cache", 7,
+                      { Requirements::Thread::audioThread, Requirements::GUI::noGUI })
+    {
+    }
+
+    void runTest (PluginTests& ut, juce::AudioPluginInstance& instance) override
+    {
+        const int evictionSizeKb = ut.getOptions().cacheEvictionSizeKb;
+
+        if (evictionSizeKb <= 0)
+        {
+            ut.logMessage ("INFO: Skipping cold cache benchmark, set a cache eviction size to run it");
+            return;
+        }
+
+        const std::vector<double>& sampleRates = ut.getOptions().sampleRates;
+        const std::vector<int>& blockSizes = ut.getOptions().blockSizes;
+
+        jassert (sampleRates.size() > 0 && blockSizes.size() > 0);
+        const double sampleRate = sampleRates[0];
+
+        CacheEvictor evictor ((size_t) evictionSizeKb * 1024);
+        auto r = ut.getRandom();
+        NoiseBank noise (r);
+
+        ut.logMessage ("Writing " + juce::File::descriptionOfSizeInBytes ((juce::int64) evictor.getSize())
+                       + " between each processBlock call at sample rate " + juce::String (sampleRate, 0));
+        ut.logMessage ("Block size, warm median, cold median, cold/warm, cold % of real-time");
+
+        for (auto bs : blockSizes)
+        {
+            callReleaseResourcesOnMessageThreadIfVST3 (instance);
+            callPrepareToPlayOnMessageThreadIfVST3 (instance, sampleRate, bs);
+
+            const int numChannelsRequired = juce::jmax (instance.getTotalNumInputChannels(), instance.getTotalNumOutputChannels());
+            auto& ab = ut.getBufferPool().getAudioBuffer (numChannelsRequired, bs);
+            auto& mb = ut.getBufferPool().getMidiBuffer();
+
+            // Evicting takes a while so use fewer blocks than the other benchmarks
+            const int numBlocks = juce::jmin (256, getNumBenchmarkBlocks (sampleRate, bs));
+            const int numWarmUpBlocks = juce::jmax (2, numBlocks / 8);
+
+            TimingStatistics warmTimings, coldTimings;
+            warmTimings.reserve (numBlocks);
+            coldTimings.reserve (numBlocks);
+
+            for (int i = 0; i < numWarmUpBlocks + numBlocks; ++i)
+            {
+                noise.fill (ab);
+                const auto seconds = timeProcessBlock (instance, ab, mb);
+                mb.clear();
+
+                if (i >= numWarmUpBlocks)
+                    warmTimings.add (seconds);
+            }
+
+            for (int i = 0; i < numBlocks; ++i)
+            {
+                noise.fill (ab);
+                evictor.evict();
+                coldTimings.add (timeProcessBlock (instance, ab, mb));
+                mb.clear();
+            }
+
+            expectValidBuffer (ut, analyseBuffer (ab));
+            ut.resetTimeout();
+
+            const auto warmMedian = warmTimings.getPercentile (50.0);
+            const auto coldMedian = coldTimings.getPercentile (50.0);
+            const auto coldRealtimePercentage = getRealtimePercentage (coldMedian, sampleRate, bs);
+
+            ut.logMessage (juce::String (bs) + ", " + juce::String (warmMedian * 1.0e6, 1) + " us, "
+                           + juce::String (coldMedian * 1.0e6, 1) + " us, "
+                           + (warmMedian > 0.0 ? juce::String (coldMedian / warmMedian, 2) + "x" : juce::String ("-")) + ", "
+                           + juce::String (coldRealtimePercentage, 2) + "%");
+            ut.logVerboseMessage ("Warm: " + warmTimings.getDescription());
+            ut.logVerboseMessage ("Cold: " + coldTimings.getDescription());
+
+            if (coldRealtimePercentage > 100.0)
+                ut.logMessage ("!!! WARNING: Misses real-time at block size " + juce::String (bs) + " with cold caches");
+        }
+    }
+};
+
+static ColdCacheTest coldCacheTest;
+
+
+//==============================================================================
+/**
+    Times processBlock whilst background threads generate CPU, memory bandwidth
+    and lock contention load, and compares the timing percentiles with an
+    unloaded run. Plugins that spin-wait or need a lot of memory bandwidth
+    degrade badly when sharing a machine with many other processes.
+    This only runs if a number of stressor threads is set in the options.
+*/
+struct ContentionTest   : public PluginTest
+{
+    ContentionTest()
+        : PluginTest ("Contention", 7,
+                      { Requirements::Thread::audioThread, Requirements::GUI::noGUI })
+    {
+    }
+
+    void runTest (PluginTests& ut, juce::AudioPluginInstance& instance) override
+    {
+        const int numThreads = ut.getOptions().stressThreads;
+        const int intensity = ut.getOptions().stressIntensity;
+
+        if (numThreads <= 0)
+        {
+            ut.logMessage ("INFO: Skipping contention benchmark, set a number of stressor threads to run it");
+            return;
+        }
+
+        jassert (ut.getOptions().sampleRates.size() > 0 && ut.getOptions().blockSizes.size() > 0);
+        const double sampleRate = ut.getOptions().sampleRates[0];
+        const int blockSize = ut.getOptions().blockSizes[0];
+
+        ut.logMessage (juce::String ("Testing with sample rate [SR] and block size [BS]")
+                           .replace ("SR",juce::String (sampleRate, 0), false)
+                           .replace ("BS",juce::String (blockSize), false));
+        ut.logMessage ("Running " + juce::String (numThreads) + " stressor threads at " + juce::String (intensity) + "% intensity");
+
+        callReleaseResourcesOnMessageThreadIfVST3 (instance);
+        callPrepareToPlayOnMessageThreadIfVST3 (instance, sampleRate, blockSize);
+
+        const int numChannelsRequired = juce::jmax (instance.getTotalNumInputChannels(), instance.getTotalNumOutputChannels());
+        auto& ab = ut.getBufferPool().getAudioBuffer (numChannelsRequired, blockSize);
+        auto& mb = ut.getBufferPool().getMidiBuffer();
+
+        auto r = ut.getRandom();
+        NoiseBank noise (r);
+
+        const int numBlocks = getNumBenchmarkBlocks (sampleRate, blockSize);
+        const auto unloaded = processBlocks (instance, noise, ab, mb, numBlocks);
+        const auto blockDuration = blockSize / sampleRate;
+
+        ut.logMessage ("Load, median, 99th percentile, max, median slowdown, 99th percentile slowdown");
+        logRow (ut, "none", unloaded, unloaded);
+
+        for (auto workload : { ContentionStressor::Workload::cpu,
+                               ContentionStressor::Workload::memoryBandwidth,
+                               ContentionStressor::Workload::lockContention })
+        {
+            TimingStatistics loaded;
+
+            {
+                ContentionStressor stressor (workload, numThreads, intensity);
+                juce::Thread::sleep (50); // Give the threads time to get going
+                loaded = processBlocks (instance, noise, ab, mb, numBlocks);
+            }
+
+            expectValidBuffer (ut, analyseBuffer (ab));
+            logRow (ut, ContentionStressor::getName (workload), loaded, unloaded);
+
+            if (loaded.getPercentile (99.0) > blockDuration && unloaded.getPercentile (99.0) <= blockDuration)
+                ut.logMessage ("!!! WARNING: Misses real-time under " + ContentionStressor::getName (workload) + " load");
+
+            ut.resetTimeout();
+        }
+    }
+
+    static TimingStatistics processBlocks (juce::AudioPluginInstance& instance, NoiseBank& noise,
+                                           juce::AudioBuffer<float>& ab, juce::MidiBuffer& mb, int numBlocks)
+    {
+        const int numWarmUpBlocks = juce::jmax (2, numBlocks / 8);
+        TimingStatistics timings;
+        timings.reserve (numBlocks);
+
+        for (int i = 0; i < numWarmUpBlocks + numBlocks; ++i)
+        {
+            noise.fill (ab);
+            const auto seconds = timeProcessBlock (instance, ab, mb);
+            mb.clear();
+
+            if (i >= numWarmUpBlocks)
+                timings.add (seconds);
+        }
+
+        return timings;
+    }
+
+    static void logRow (PluginTests& ut, const juce::String& load, const TimingStatistics& loaded, const TimingStatistics& unloaded)
+    {
+        auto getRatio = [] (double value, double reference)
+        {
+            return reference > 0.0 ? juce::String (value / reference, 2) + "x" : juce::String ("-");
+        };
+
+        const auto median = loaded.getPercentile (50.0);
+        const auto p99 = loaded.getPercentile (99.0);
+
+        ut.logMessage (load + ", " + juce::String (median * 1.0e6, 1) + " us, "
+                       + juce::String (p99 * 1.0e6, 1) + " us, "
+                       + juce::String (loaded.getMax() * 1.0e6, 1) + " us, "
+                       + getRatio (median, unloaded.getPercentile (50.0)) + ", "
+                       + getRatio (p99, unloaded.getPercentile (99.0)));
+    }
+};
+
+static ContentionTest contentionTest;
+
+
+//==============================================================================
+/**
+    Finds how many instances of the plugin one core can run in real-time.
+    Instances are processed one after another on the audio thread once per
+    callback period, and the count is searched until the 99th percentile
+    callback time no longer fits in the budget, which leaves some headroom for
+    the host. Instances are created on this thread before each step of the
+    search so only processing is ever timed on the audio thread.
+*/
+struct RealtimeCapacityTest : public PluginTest
+{
+    RealtimeCapacityTest()
+        : PluginTest ("Real-time capacity", 8,
+                      { Requirements::Thread::backgroundThread, Requirements::GUI::noGUI })
+    {
+    }
+
+    static constexpr int maxNumInstances = 128;
+    static constexpr double budgetProportion = 0.7;
+
+    void runTest (PluginTests& ut, juce::AudioPluginInstance& instance) override
+    {
+        jassert (ut.getOptions().sampleRates.size() > 0 && ut.getOptions().blockSizes.size() > 0);
+        const double sampleRate = ut.getOptions().sampleRates[0];
+        const int blockSize = ut.getOptions().blockSizes[0];
+        const double period = blockSize / sampleRate;
+        const double budget = period * budgetProportion;
+
+        ut.logMessage (juce::String ("Testing with sample rate [SR] and block size [BS]")
+                           .replace ("SR",juce::String (sampleRate, 0), false)
+                           .replace ("BS",juce::String (blockSize), false));
+        ut.logMessage ("Callback budget: " + juce::String (budget * 1.0e6, 1) + " us ("
+                       + juce::String (juce::roundToInt (budgetProportion * 100.0)) + "% of the "
+                       + juce::String (period * 1.0e6, 1) + " us period)");
+
+        callReleaseResourcesOnMessageThreadIfVST3 (instance);
+        callPrepareToPlayOnMessageThreadIfVST3 (instance, sampleRate, blockSize);
+
+        auto r = ut.getRandom();
+        NoiseBank noise (r);
+        auto& mb = ut.getBufferPool().getMidiBuffer();
+
+        std::vector<std::unique_ptr<juce::AudioPluginInstance>> extraInstances;
+        juce::Array<juce::AudioPluginInstance*> instances;
+
+        const int numChannels = juce::jmax (instance.getTotalNumInputChannels(), instance.getTotalNumOutputChannels());
+        auto& ab = ut.getBufferPool().getAudioBuffer (numChannels, blockSize);
+
+        // Processes a single block on this thread, starting or stopping a note so instruments are doing some work
+        auto sendNote = [&] (juce::AudioPluginInstance& p, bool isNoteOn)
+        {
+            if (isNoteOn)
+                addNoteOn (mb, 1, 60, 0);
+            else
+                addNoteOff (mb, 1, 60, 0);
+
+            noise.fill (ab);
+            p.processBlock (ab, mb);
+            mb.clear();
+        };
+
+        sendNote (instance, true);
+        instances.add (&instance);
+
+        // Creates instances until there are this many, returning false if one couldn't be created
+        auto createInstances = [&] (int numInstances)
+        {
+            while (instances.size() < numInstances)
+            {
+                juce::String errorMessage;
+                auto newInstance = ut.createPluginInstance (instance.getPluginDescription(), sampleRate, blockSize, errorMessage);
+
+                if (newInstance == nullptr)
+                {
+                    ut.logMessage ("!!! WARNING: Unable to create instance " + juce::String (instances.size() + 1) + ": " + errorMessage);
+                    return false;
+                }
+
+                callPrepareToPlayOnMessageThreadIfVST3 (*newInstance, sampleRate, blockSize);
+                sendNote (*newInstance, true);
+                instances.add (newInstance.get());
+                extraInstances.push_back (std::move (newInstance));
+                ut.resetTimeout();
+            }
+
+            return true;
+        };
+
+        // Returns true if this many of the already created instances fit in the budget
+        auto fitsInBudget = [&] (int numInstances)
+        {
+            jassert (numInstances <= instances.size());
+            CallbackDeadlineResults results;
+
+            ut.callOnAudioThread ([&]
+                                  {
+                                      results = simulateAudioCallbacks ([&]
+                                                                        {
+                                                                            for (int i = 0; i < numInstances; ++i)
+                                                                            {
+                                                                                noise.fill (ab);
+                                                                                instances.getUnchecked (i)->processBlock (ab, mb);
+                                                                                mb.clear();
+                                                                            }
+                                                                        },
+                                                                        period, getNumBenchmarkBlocks (sampleRate, blockSize, 1.0));
+                                  });
+
+            const auto p99 = results.timings.getPercentile (99.0);
+            ut.logVerboseMessage (juce::String (numInstances) + " instances: " + results.timings.getDescription()
+                                  + ", " + juce::String (results.numMissedDeadlines) + " missed deadlines");
+            ut.resetTimeout();
+
+            return p99 <= budget;
+        };
+
+        // Double the count until it no longer fits, then binary search between the last two counts.
+        // All the instances the binary search needs already exist once the doubling stops.
+        int lastFit = 0, firstMiss = 0;
+
+        for (int numInstances = 1; numInstances <= maxNumInstances; numInstances *= 2)
+        {
+            if (! createInstances (numInstances))
+            {
+                // Search up to the number that could be created
+                firstMiss = instances.size() + 1;
+                break;
+            }
+
+            if (! fitsInBudget (numInstances))
+            {
+                firstMiss = numInstances;
+                break;
+            }
+
+            lastFit = numInstances;
+        }
+
+        while (firstMiss > 0 && firstMiss - lastFit > 1)
+        {
+            const int numInstances = (lastFit + firstMiss) / 2;
+
+            if (fitsInBudget (numInstances))
+                lastFit = numInstances;
+            else
+                firstMiss = numInstances;
+        }
+
+        expectValidBuffer (ut, analyseBuffer (ab));
+
+        for (auto p : instances)
+            sendNote (*p, false);
+
+        deleteInstancesOnMessageThread (std::move (extraInstances));
+
+        if (lastFit == 0)
+            ut.logMessage ("!!! WARNING: A single instance doesn't fit in the callback budget at this block size");
+        else
+            ut.logMessage ("Real-time capacity: " + juce::String (lastFit) + (firstMiss == 0 ? " or more" : "")
+                           + " instances per core at " + juce::String (sampleRate, 0) + " Hz, block size " + juce::String (blockSize)
+                           + ", with " + juce::String (juce::roundToInt ((1.0 - budgetProportion) * 100.0)) + "% headroom");
+    }
+
+    static void deleteInstancesOnMessageThread (std::vector<std::unique_ptr<juce::AudioPluginInstance>> instances)
+    {
+        for (auto& i : instances)
+            callReleaseResourcesOnMessageThreadIfVST3 (*i);
+
+        juce::WaitableEvent waiter;
+        juce::MessageManager::callAsync ([&]
+                                   {
+                                       instances.clear();
+                                       juce::Thread::sleep (150); // Pause a few ms to let the plugins clean up after themselves
+                                       waiter.signal();
+                                   });
+        waiter.wait();
+    }
+};
+
+static RealtimeCapacityTest realtimeCapacityTest;
+
+
+//==============================================================================
+/**
+    Finds the smallest block size at which a single instance runs for the
+    number of seconds of simulated audio callbacks set in the options without
+    a callback overrunning its budget, which leaves some headroom for the host. This is independent of
+    the block sizes in the options so it gives a minimum buffer setting to use
+    when playing live.
+*/
+struct MinimumBufferSizeTest    : public PluginTest
+{
+    MinimumBufferSizeTest()
+        : PluginTest ("Minimum buffer size", 8,
+                      { Requirements::Thread::audioThread, Requirements::GUI::noGUI })
+    {
+    }
+
+    static constexpr double budgetProportion = 0.7;
+
+    void runTest (PluginTests& ut, juce::AudioPluginInstance& instance) override
+    {
+        jassert (ut.getOptions().sampleRates.size() > 0);
+        const double sampleRate = ut.getOptions().sampleRates[0];
+        const double secondsPerBlockSize = ut.getOptions().minimumBufferSeconds;
+        const std::array<int, 8> candidateSizes { 16, 32, 64, 128, 256, 512, 1024, 2048 };
+
+        ut.logMessage ("Testing with sample rate " + juce::String (sampleRate, 0) + ", allowing callbacks "
+                       + juce::String (juce::roundToInt (budgetProportion * 100.0)) + "% of each period, for "
+                       + juce::String (secondsPerBlockSize, 0) + " s at each block size");
+
+        auto r = ut.getRandom();
+        NoiseBank noise (r);
+
+        // Assume cost per sample falls as block size grows, check the largest size
+        // then binary search for the smallest that doesn't miss a deadline
+        int firstFailIndex = -1, lastPassIndex = (int) candidateSizes.size() - 1;
+
+        if (! runsWithoutMissingDeadlines (ut, instance, noise, sampleRate, secondsPerBlockSize, candidateSizes[(size_t) lastPassIndex]))
+        {
+            ut.logMessage ("!!! WARNING: Misses deadlines at every block size up to " + juce::String (candidateSizes.back()));
+            return;
+        }
+
+        while (lastPassIndex - firstFailIndex > 1)
+        {
+            const int index = (firstFailIndex + lastPassIndex) / 2;
+
+            if (runsWithoutMissingDeadlines (ut, instance, noise, sampleRate, secondsPerBlockSize, candidateSizes[(size_t) index]))
+                lastPassIndex = index;
+            else
+                firstFailIndex = index;
+        }
+
+        const int minimumSize = candidateSizes[(size_t) lastPassIndex];
+        ut.logMessage ("Minimum sustainable block size: " + juce::String (minimumSize) + " samples ("
+                       + juce::String (minimumSize * 1000.0 / sampleRate, 2) + " ms at " + juce::String (sampleRate, 0) + " Hz)");
+    }
+
+    static bool runsWithoutMissingDeadlines (PluginTests& ut, juce::AudioPluginInstance& instance, NoiseBank& noise,
+                                             double sampleRate, double secondsPerBlockSize, int blockSize)
+    {
+        callReleaseResourcesOnMessageThreadIfVST3 (instance);
+        callPrepareToPlayOnMessageThreadIfVST3 (instance, sampleRate, blockSize);
+
+        const int numChannelsRequired = juce::jmax (instance.getTotalNumInputChannels(), instance.getTotalNumOutputChannels());
+        auto& ab = ut.getBufferPool().getAudioBuffer (numChannelsRequired, blockSize);
+        auto& mb = ut.getBufferPool().getMidiBuffer();
+
+        // Hold a note throughout so instruments are doing some work
+        addNoteOn (mb, 1, 60, 0);
+
+        const auto period = blockSize / sampleRate;
+        const auto numCallbacks = juce::roundToInt (secondsPerBlockSize / period);
+        const auto results = simulateAudioCallbacks ([&]
+                                                     {
+                                                         noise.fill (ab);
+                                                         instance.processBlock (ab, mb);
+                                                         mb.clear();
+                                                     },
+                                                     period, numCallbacks, budgetProportion);
+
+        addNoteOff (mb, 1, 60, 0);
+        noise.fill (ab);
+        instance.processBlock (ab, mb);
+        mb.clear();
+
+        expectValidBuffer (ut, analyseBuffer (ab));
+        ut.logMessage ("Block size " + juce::String (blockSize) + ": " + juce::String (results.numMissedDeadlines)
+                       + " missed deadlines in " + juce::String (numCallbacks) + " callbacks");
+        ut.logVerboseMessage (results.timings.getDescription());
+        ut.resetTimeout();
+
+        return results.numMissedDeadlines == 0;
+    }
+};
+
+static MinimumBufferSizeTest minimumBufferSizeTest;
@@ -111,3 +111,338 @@ struct BasicBusTest   : public PluginTest
 };
 
 static BasicBusTest basicBusTest;
+
+
+//==============================================================================
+/**
+    Switches the main buses to each supported layout from mono up to immersive,
+    ambisonic and large discrete layouts, then processes audio in each one,
+    checking the output and timing it. Reports the cost per channel so it's
+    clear whether the plugin scales linearly with the channel count.
+*/
+struct BusLayoutCostTest    : public PluginTest
+{
+    BusLayoutCostTest()
+        : PluginTest ("Bus layout cost", 7,
+                      { Requirements::Thread::backgroundThread, Requirements::GUI::noGUI })
+    {
+    }
+
+    void runTest (PluginTests& ut, juce::AudioPluginInstance& instance) override
+    {
+        const std::vector<double>& sampleRates = ut.getOptions().sampleRates;
+        const std::vector<int>& blockSizes = ut.getOptions().blockSizes;
+
+        jassert (sampleRates.size() > 0 && blockSizes.size() > 0);
+        const double sampleRate = sampleRates[0];
+        const int blockSize = blockSizes[0];
+        const bool isPluginInstrument = instance.getPluginDescription().isInstrument;
+
+        const ScopedPluginDeinitialiser deinitialiser (instance);
+        const ScopedBusesLayout scopedLayout (instance);
+        const auto layouts = getSupportedMainBusLayouts (instance);
+
+        if (layouts.isEmpty())
+        {
+            ut.logMessage ("INFO: Skipping test as no alternative main bus layouts are supported");
+            return;
+        }
+
+        auto r = ut.getRandom();
+        NoiseBank noise (r);
+        const int numBlocks = getNumBenchmarkBlocks (sampleRate, blockSize, 0.25);
+        std::vector<double> channelCounts, medianTimes;
+
+        ut.logMessage ("Layout, input channels, output channels, median time, time per channel");
+
+        for (auto& layout : layouts)
+        {
+            callReleaseResourcesOnMessageThreadIfVST3 (instance);
+
+            if (! instance.setBusesLayout (layout))
+            {
+                ut.logMessage ("!!! WARNING: Unable to set supported layout: " + getDescription (layout));
+                continue;
+            }
+
+            callPrepareToPlayOnMessageThreadIfVST3 (instance, sampleRate, blockSize);
+
+            const int numInputChannels = instance.getTotalNumInputChannels();
+            const int numOutputChannels = instance.getTotalNumOutputChannels();
+            auto& ab = ut.getBufferPool().getAudioBuffer (juce::jmax (numInputChannels, numOutputChannels), blockSize);
+            auto& mb = ut.getBufferPool().getMidiBuffer();
+
+            TimingStatistics timings;
+            timings.reserve (numBlocks);
+
+            // Hold a note throughout so instruments produce a signal
+            if (isPluginInstrument)
+                addNoteOn (mb, 1, 60, 0);
+
+            for (int i = 0; i < numBlocks; ++i)
+            {
+                noise.fill (ab);
+                timings.add (timeProcessBlock (instance, ab, mb));
+                mb.clear();
+
+                expectValidBuffer (ut, analyseBuffer (ab));
+            }
+
+            if (isPluginInstrument)
+            {
+                addNoteOff (mb, 1, 60, 0);
+                noise.fill (ab);
+                instance.processBlock (ab, mb);
+                mb.clear();
+            }
+
+            const int numChannels = juce::jmax (1, numInputChannels, numOutputChannels);
+            const auto median = timings.getPercentile (50.0);
+            channelCounts.push_back (numChannels);
+            medianTimes.push_back (median);
+
+            ut.logMessage (getDescription (layout) + ", " + juce::String (numInputChannels) + ", " + juce::String (numOutputChannels) + ", "
+                           + juce::String (median * 1.0e6, 1) + " us, " + juce::String (median * 1.0e6 / numChannels, 2) + " us");
+            ut.resetTimeout();
+        }
+
+        if (channelCounts.size() > 1)
+        {
+            const auto fit = fitLine (channelCounts, medianTimes, false);
+            ut.logMessage ("Linear fit: " + juce::String (fit.intercept * 1.0e6, 2) + " us + "
+                           + juce::String (fit.slope * 1.0e6, 2) + " us per channel");
+
+            const auto maxIndex = (size_t) std::distance (channelCounts.begin(), std::max_element (channelCounts.begin(), channelCounts.end()));
+            const auto predicted = fit.getValue (channelCounts[maxIndex]);
+
+            if (predicted > 0.0)
+                ut.logMessage ("Largest layout costs " + juce::String (medianTimes[maxIndex] / predicted, 2)
+                               + "x what linear scaling predicts");
+        }
+
+        // Restore the layout whilst released, the deinitialiser will prepare again
+        callReleaseResourcesOnMessageThreadIfVST3 (instance);
+    }
+
+    static juce::String getDescription (const juce::AudioProcessor::BusesLayout& layout)
+    {
+        const auto& mainBus = layout.outputBuses.isEmpty() ? layout.getMainInputChannelSet() : layout.getMainOutputChannelSet();
+        return mainBus.getDescription();
+    }
+
+    /** Returns the layouts with the main buses set to each of a range of common
+        channel sets that the plugin supports, keeping the other buses as they are.
+    */
+    static juce::Array<juce::AudioProcessor::BusesLayout> getSupportedMainBusLayouts (juce::AudioPluginInstance& instance)
+    {
+        juce::Array<juce::AudioChannelSet> sets { juce::AudioChannelSet::mono(),
+                                                  juce::AudioChannelSet::stereo(),
+                                                  juce::AudioChannelSet::createLCR(),
+                                                  juce::AudioChannelSet::quadraphonic(),
+                                                  juce::AudioChannelSet::create5point1(),
+                                                  juce::AudioChannelSet::create7point1(),
+                                                  juce::AudioChannelSet::create7point1point4(),
+                                                  juce::AudioChannelSet::ambisonic (1),
+                                                  juce::AudioChannelSet::ambisonic (2),
+                                                  juce::AudioChannelSet::ambisonic (3) };
+
+        for (int numChannels : { 1, 2, 4, 8, 16, 32 })
+            sets.add (juce::AudioChannelSet::discreteChannels (numChannels));
+
+        const auto currentLayout = instance.getBusesLayout();
+        juce::Array<juce::AudioProcessor::BusesLayout> layouts;
+
+        for (auto& set : sets)
+        {
+            auto layout = currentLayout;
+
+            if (! layout.inputBuses.isEmpty())
+                layout.inputBuses.getReference (0) = set;
+
+            if (! layout.outputBuses.isEmpty())
+                layout.outputBuses.getReference (0) = set;
+
+            // Some plugins only allow the output layout to change e.g. mono to stereo
+            if (! instance.checkBusesLayoutSupported (layout) && ! layout.inputBuses.isEmpty())
+                layout.inputBuses.getReference (0) = currentLayout.inputBuses.getReference (0);
+
+            if (instance.checkBusesLayoutSupported (layout) && ! layouts.contains (layout))
+                layouts.add (layout);
+        }
+
+        return layouts;
+    }
+};
+
+static BusLayoutCostTest busLayoutCostTest;
+
+
+//==============================================================================
+/**
+    Enables each non-main input and output bus in turn, and then all of them,
+    feeding a different stimulus to every input bus and checking every output
+    bus. Sidechain paths often take slower code paths or allocate on first use
+    so the cost and any allocations are compared with all aux buses disabled.
+*/
+struct AuxBusProcessingTest : public PluginTest
+{
+    AuxBusProcessingTest()
+        : PluginTest ("Aux bus processing", 7,
+                      { Requirements::Thread::backgroundThread, Requirements::GUI::noGUI })
+    {
+    }
+
+    void runTest (PluginTests& ut, juce::AudioPluginInstance& instance) override
+    {
+        if (instance.getBusCount (true) <= 1 && instance.getBusCount (false) <= 1)
+        {
+            ut.logMessage ("INFO: Skipping test as plugin has no aux buses");
+            return;
+        }
+
+        const std::vector<double>& sampleRates = ut.getOptions().sampleRates;
+        const std::vector<int>& blockSizes = ut.getOptions().blockSizes;
+
+        jassert (sampleRates.size() > 0 && blockSizes.size() > 0);
+        const double sampleRate = sampleRates[0];
+        const int blockSize = blockSizes[0];
+
+        const ScopedPluginDeinitialiser deinitialiser (instance);
+        const ScopedBusesLayout scopedLayout (instance);
+
+        auto r = ut.getRandom();
+        StimulusLibrary stimuli (r);
+
+        if (! instance.disableNonMainBuses())
+            ut.logMessage ("!!! WARNING: Disabling non-main buses failed");
+
+        const auto baseline = processAndTime (ut, instance, stimuli, sampleRate, blockSize);
+        ut.logMessage ("Aux buses disabled: " + juce::String (baseline.medianTime * 1.0e6, 1) + " us");
+        checkAllocations (ut, baseline.numAllocations, "processing with aux buses disabled");
+
+        const auto disabledLayout = instance.getBusesLayout();
+
+        for (auto isInput : { true, false })
+        {
+            for (int busIndex = 1; busIndex < instance.getBusCount (isInput); ++busIndex)
+            {
+                auto* bus = instance.getBus (isInput, busIndex);
+
+                if (bus == nullptr)
+                    continue;
+
+                const auto busName = juce::String (isInput ? "input" : "output") + " bus \"" + bus->getName() + "\"";
+
+                callReleaseResourcesOnMessageThreadIfVST3 (instance);
+                instance.setBusesLayout (disabledLayout);
+
+                if (! bus->enable())
+                {
+                    ut.logMessage ("INFO: Unable to enable " + busName);
+                    continue;
+                }
+
+                checkAgainstBaseline (ut, busName + " enabled", baseline,
+                                      processAndTime (ut, instance, stimuli, sampleRate, blockSize));
+            }
+        }
+
+        callReleaseResourcesOnMessageThreadIfVST3 (instance);
+
+        if (instance.enableAllBuses())
+            checkAgainstBaseline (ut, "all buses enabled", baseline,
+                                  processAndTime (ut, instance, stimuli, sampleRate, blockSize));
+        else
+            ut.logMessage ("!!! WARNING: Enabling all buses failed");
+
+        // Restore the layout whilst released, the deinitialiser will prepare again
+        callReleaseResourcesOnMessageThreadIfVST3 (instance);
+    }
+
+    struct Results
+    {
+        double medianTime = 0.0;
+        int numAllocations = 0;
+    };
+
+    /** Prepares the plugin in its current layout and processes a distinct stimulus on each input bus. */
+    static Results processAndTime (PluginTests& ut, juce::AudioPluginInstance& instance, StimulusLibrary& stimuli,
+                                   double sampleRate, int blockSize)
+    {
+        callReleaseResourcesOnMessageThreadIfVST3 (instance);
+        callPrepareToPlayOnMessageThreadIfVST3 (instance, sampleRate, blockSize);
+
+        const int numChannelsRequired = juce::jmax (instance.getTotalNumInputChannels(), instance.getTotalNumOutputChannels());
+        auto& ab = ut.getBufferPool().getAudioBuffer (numChannelsRequired, blockSize);
+        auto& mb = ut.getBufferPool().getMidiBuffer();
+
+        const int numBlocks = getNumBenchmarkBlocks (sampleRate, blockSize, 0.25);
+        const bool isPluginInstrument = instance.getPluginDescription().isInstrument;
+        TimingStatistics timings;
+        timings.reserve (numBlocks);
+        Results results;
+
+        // Hold a note throughout so instruments produce a signal on every output bus
+        if (isPluginInstrument)
+            addNoteOn (mb, 1, 60, 0);
+
+        // Only signals that are never silent so every aux input, e.g. a sidechain, gets something to react to
+        const StimulusLibrary::Type busStimuli[] { StimulusLibrary::whiteNoise, StimulusLibrary::impulses,
+                                                   StimulusLibrary::nyquistSweep, StimulusLibrary::interSamplePeaks,
+                                                   StimulusLibrary::fullScaleDC };
+        const int numBusStimuli = juce::numElementsInArray (busStimuli);
+
+        // Allocations are counted from the first block as that's when they tend to happen
+        for (int i = 0; i < numBlocks; ++i)
+        {
+            ab.clear();
+
+            for (int busIndex = 0; busIndex < instance.getBusCount (true); ++busIndex)
+            {
+                auto busBuffer = instance.getBusBuffer (ab, true, busIndex);
+                stimuli.fill (busStimuli[busIndex % numBusStimuli], busBuffer);
+            }
+
+            timings.add (timeProcessBlockWithoutAllocating (instance, ab, mb, results.numAllocations));
+            mb.clear();
+
+            for (int busIndex = 0; busIndex < instance.getBusCount (false); ++busIndex)
+            {
+                const auto analysis = analyseBuffer (instance.getBusBuffer (ab, false, busIndex));
+
+                ut.expect (analysis.isValid(), "Invalid output on output bus " + juce::String (busIndex)
+                                                 + " (NaNs: " + juce::String (analysis.numNaNs)
+                                                 + ", Infs: " + juce::String (analysis.numInfs)
+                                                 + ", subnormals: " + juce::String (analysis.numSubnormals) + ")");
+            }
+        }
+
+        if (isPluginInstrument)
+        {
+            addNoteOff (mb, 1, 60, 0);
+            ab.clear();
+            instance.processBlock (ab, mb);
+            mb.clear();
+        }
+
+        ut.resetTimeout();
+        results.medianTime = timings.getPercentile (50.0);
+
+        return results;
+    }
+
+    static void checkAgainstBaseline (PluginTests& ut, const juce::String& description, const Results& baseline, const Results& results)
+    {
+        const auto ratio = baseline.medianTime > 0.0 ? results.medianTime / baseline.medianTime : 1.0;
+        ut.logMessage ("With " + description + ": " + juce::String (results.medianTime * 1.0e6, 1) + " us, "
+                       + juce::String (ratio, 2) + "x the cost with aux buses disabled");
+
+        if (ratio > 2.0)
+            ut.logMessage ("!!! WARNING: Processing with " + description + " costs more than twice as much");
+
+        if (baseline.numAllocations == 0)
+            checkAllocations (ut, results.numAllocations, "processing with " + description);
+    }
+};
+
+static AuxBusProcessingTest auxBusProcessingTest;
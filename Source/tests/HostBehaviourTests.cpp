@@ -0,0 +1,531 @@
+/*==============================================================================
+
+  Copyright 2018 by Tracktion Corporation.
+  For more information visit www.tracktion.com
+
+   You may also use this code under the terms of the GPL v3 (see
+   www.gnu.org/licenses).
+
+   pluginval IS PROVIDED "AS IS" WITHOUT ANY WARRANTY, AND ALL WARRANTIES, WHETHER
+   EXPRESSED OR IMPLIED, INCLUDING MERCHANTABILITY AND FITNESS FOR PURPOSE, ARE
+   DISCLAIMED.
+
+ ==============================================================================*/
+
+#include "../PluginTests.h"
+#include "../TestUtilities.h"
+
+namespace
+{
+    /** An AudioBuffer that refers to channels in memory owned by this, rather than
+        allocated by the AudioBuffer, placed at a controlled offset from a 64 byte
+        boundary. Each channel has a guard region either side of it so writes
+        outside the buffer can be detected.
+    */
+    class ExternalChannelBuffers
+    {
+    public:
+        /** Creates the channels.
+            @param numChannels          The number of channels
+            @param numSamples           The number of samples per channel
+            @param misalignmentFloats   The number of floats past a 64 byte boundary each channel starts
+            @param scatterChannels      If true, each channel is a separate allocation with a different
+                                        misalignment and the channels are in reverse address order
+        */
+        ExternalChannelBuffers (int numChannels, int numSamples, int misalignmentFloats, bool scatterChannels)
+            : scattered (scatterChannels), misalignment (misalignmentFloats)
+        {
+            // Keep every channel the same distance from a boundary by padding them to a whole number of boundaries
+            const int paddedNumSamples = (numSamples + alignmentFloats - 1) / alignmentFloats * alignmentFloats;
+            const auto channelStride = (size_t) (guardSize + paddedNumSamples + guardSize + alignmentFloats);
+
+            for (int ch = 0; ch < numChannels; ++ch)
+            {
+                if (scattered || ch == 0)
+                    storage.emplace_back ((scattered ? channelStride : channelStride * (size_t) numChannels) + alignmentFloats);
+
+                auto* base = juce::snapPointerToAlignment (storage.back().data(), (size_t) (alignmentFloats * sizeof (float)));
+
+                if (! scattered)
+                    base += channelStride * (size_t) ch;
+
+                const int offset = scattered ? (misalignment + ch) % alignmentFloats : misalignment;
+                channels.push_back (base + guardSize + offset);
+            }
+
+            if (scattered)
+                std::reverse (channels.begin(), channels.end());
+
+            for (auto* channel : channels)
+            {
+                std::fill (channel - guardSize, channel, guardValue);
+                std::fill (channel + numSamples, channel + numSamples + guardSize, guardValue);
+            }
+
+            // With no channels there's no array to refer to, so leave the buffer empty
+            if (numChannels > 0)
+                buffer.setDataToReferTo (channels.data(), numChannels, numSamples);
+        }
+
+        juce::AudioBuffer<float>& getBuffer() noexcept     { return buffer; }
+
+        /** Returns true if nothing has written to the regions either side of the channels. */
+        bool guardsAreIntact() const noexcept
+        {
+            for (auto* channel : channels)
+                for (int i = 0; i < guardSize; ++i)
+                    if (channel[i - guardSize] != guardValue || channel[buffer.getNumSamples() + i] != guardValue)
+                        return false;
+
+            return true;
+        }
+
+        juce::String getDescription() const
+        {
+            if (scattered)
+                return "scattered channels";
+
+            return misalignment == 0 ? juce::String ("64 byte aligned")
+                                     : juce::String (misalignment * (int) sizeof (float)) + " bytes past alignment";
+        }
+
+    private:
+        static constexpr int alignmentFloats = 16, guardSize = 16;
+        static constexpr float guardValue = 12345.0f;
+
+        const bool scattered;
+        const int misalignment;
+        std::vector<std::vector<float>> storage;
+        std::vector<float*> channels;
+        juce::AudioBuffer<float> buffer;
+
+        JUCE_DECLARE_NON_COPYABLE (ExternalChannelBuffers)
+    };
+}
+
+
+//==============================================================================
+/**
+    Hosts don't always pass buffers that are contiguous and aligned in the way
+    juce::AudioBuffer allocates them. Channels can be only 4 byte aligned or come
+    from separate allocations. This processes audio in buffers over externally
+    owned memory with controlled misalignment and scattered channels, checking
+    the output is valid, that nothing is written outside the channels and
+    comparing the timing with the aligned case.
+*/
+struct MisalignedBuffersTest    : public PluginTest
+{
+    MisalignedBuffersTest()
+        : PluginTest ("Misaligned buffers", 6,
+                      { Requirements::Thread::audioThread, Requirements::GUI::noGUI })
+    {
+    }
+
+    void runTest (PluginTests& ut, juce::AudioPluginInstance& instance) override
+    {
+        const std::vector<double>& sampleRates = ut.getOptions().sampleRates;
+        const std::vector<int>& blockSizes = ut.getOptions().blockSizes;
+
+        jassert (sampleRates.size() > 0 && blockSizes.size() > 0);
+        const double sampleRate = sampleRates[0];
+        const bool isPluginInstrument = instance.getPluginDescription().isInstrument;
+
+        if (juce::jmax (instance.getTotalNumInputChannels(), instance.getTotalNumOutputChannels()) == 0)
+        {
+            ut.logMessage ("INFO: Skipping test as plugin has no audio channels");
+            return;
+        }
+
+        auto r = ut.getRandom();
+        NoiseBank noise (r);
+        auto& mb = ut.getBufferPool().getMidiBuffer();
+
+        for (auto bs : blockSizes)
+        {
+            ut.logMessage (juce::String ("Testing with sample rate [SR] and block size [BS]")
+                               .replace ("SR",juce::String (sampleRate, 0), false)
+                               .replace ("BS",juce::String (bs), false));
+
+            callReleaseResourcesOnMessageThreadIfVST3 (instance);
+            callPrepareToPlayOnMessageThreadIfVST3 (instance, sampleRate, bs);
+
+            const int numChannelsRequired = juce::jmax (instance.getTotalNumInputChannels(), instance.getTotalNumOutputChannels());
+            const int numBlocks = getNumBenchmarkBlocks (sampleRate, bs, 0.25);
+            const int numWarmUpBlocks = juce::jmax (2, numBlocks / 8);
+            double alignedMedian = 0.0;
+
+            for (auto [misalignment, scattered] : { std::pair (0, false), std::pair (1, false), std::pair (2, false),
+                                                    std::pair (4, false), std::pair (1, true) })
+            {
+                ExternalChannelBuffers channels (numChannelsRequired, bs, misalignment, scattered);
+                auto& ab = channels.getBuffer();
+
+                TimingStatistics timings;
+                timings.reserve (numBlocks);
+                bool guardsIntact = true;
+
+                // Warm up each configuration so the first one isn't charged for cold caches and first-call work
+                for (int i = 0; i < numWarmUpBlocks + numBlocks; ++i)
+                {
+                    // Hold a note for the whole run so instruments produce a signal
+                    if (isPluginInstrument && i == 0)
+                        addNoteOn (mb, 1, 60, 0);
+                    else if (isPluginInstrument && i == (numWarmUpBlocks + numBlocks - 1))
+                        addNoteOff (mb, 1, 60, 0);
+
+                    noise.fill (ab);
+                    const auto seconds = timeProcessBlock (instance, ab, mb);
+                    mb.clear();
+
+                    if (i >= numWarmUpBlocks)
+                        timings.add (seconds);
+
+                    guardsIntact = guardsIntact && channels.guardsAreIntact();
+                }
+
+                expectValidBuffer (ut, analyseBuffer (ab));
+                ut.expect (guardsIntact, "Plugin wrote outside the channel buffers with " + channels.getDescription());
+
+                const auto median = timings.getPercentile (50.0);
+                const bool isAligned = misalignment == 0 && ! scattered;
+
+                if (isAligned)
+                    alignedMedian = median;
+
+                const auto ratio = ! isAligned && alignedMedian > 0.0 ? median / alignedMedian : 0.0;
+                ut.logMessage (channels.getDescription() + ": " + juce::String (median * 1.0e6, 1) + " us"
+                               + (ratio > 0.0 ? ", " + juce::String (ratio, 2) + "x aligned" : juce::String()));
+                ut.logVerboseMessage (timings.getDescription());
+
+                if (ratio > 1.5)
+                    ut.logMessage ("!!! WARNING: Processing is " + juce::String (ratio, 1) + "x slower with "
+                                   + channels.getDescription() + ", the plugin may fall back to a slow path");
+            }
+
+            ut.resetTimeout();
+        }
+    }
+};
+
+static MisalignedBuffersTest misalignedBuffersTest;
+
+
+//==============================================================================
+/**
+    Hosts that split blocks at automation points or loop boundaries call
+    processBlock with a different number of samples each time, up to the
+    prepared size. This prepares at each block size then processes random
+    sizes from 0 up to it, checking the output and for allocations, and
+    comparing the cost with processing full blocks. Plugins that reallocate or
+    recompute coefficients whenever the size changes show up as spikes.
+*/
+struct VariableBlockSizeTest    : public PluginTest
+{
+    VariableBlockSizeTest()
+        : PluginTest ("Variable block sizes", 6,
+                      { Requirements::Thread::audioThread, Requirements::GUI::noGUI })
+    {
+    }
+
+    void runTest (PluginTests& ut, juce::AudioPluginInstance& instance) override
+    {
+        const bool isPluginInstrument = instance.getPluginDescription().isInstrument;
+
+        const std::vector<double>& sampleRates = ut.getOptions().sampleRates;
+        const std::vector<int>& blockSizes = ut.getOptions().blockSizes;
+
+        jassert (sampleRates.size() > 0 && blockSizes.size() > 0);
+        const double sampleRate = sampleRates[0];
+        const int numCalls = 512;
+
+        auto r = ut.getRandom();
+        NoiseBank noise (r);
+        auto& mb = ut.getBufferPool().getMidiBuffer();
+
+        for (auto bs : blockSizes)
+        {
+            ut.logMessage (juce::String ("Testing with sample rate [SR] and block size [BS]")
+                               .replace ("SR",juce::String (sampleRate, 0), false)
+                               .replace ("BS",juce::String (bs), false));
+
+            callReleaseResourcesOnMessageThreadIfVST3 (instance);
+            callPrepareToPlayOnMessageThreadIfVST3 (instance, sampleRate, bs);
+
+            const int numChannelsRequired = juce::jmax (instance.getTotalNumInputChannels(), instance.getTotalNumOutputChannels());
+            auto& ab = ut.getBufferPool().getAudioBuffer (numChannelsRequired, bs);
+
+            // Hold a note through both phases so instruments are compared producing the same signal
+            if (isPluginInstrument)
+                addNoteOn (mb, 1, 60, 0);
+
+            // Process full blocks first for a baseline
+            TimingStatistics fixedTimings;
+            fixedTimings.reserve (numCalls / 2);
+
+            for (int i = 0; i < numCalls / 2; ++i)
+            {
+                noise.fill (ab);
+                fixedTimings.add (timeProcessBlock (instance, ab, mb));
+                mb.clear();
+            }
+
+            // Pick the sizes up front, making sure empty and single sample blocks are common
+            std::vector<int> sizes ((size_t) numCalls);
+
+            for (auto& size : sizes)
+            {
+                const int choice = r.nextInt (10);
+                size = choice == 0 ? 0 : (choice == 1 || bs < 2 ? 1 : r.nextInt ({ 2, bs + 1 }));
+            }
+
+            StimulusResults results;
+            results.timing.reserve (numCalls);
+            TimingStatistics emptyTimings;
+            emptyTimings.reserve (numCalls);
+            double totalSeconds = 0.0;
+            juce::int64 totalSamples = 0;
+            int numAllocations = 0;
+
+            for (auto size : sizes)
+            {
+                juce::AudioBuffer<float> subBuffer (ab.getArrayOfWritePointers(), ab.getNumChannels(), size);
+                noise.fill (subBuffer);
+
+                const auto seconds = timeProcessBlockWithoutAllocating (instance, subBuffer, mb, numAllocations);
+                mb.clear();
+
+                results.add (seconds, analyseBuffer (subBuffer));
+                totalSeconds += seconds;
+                totalSamples += size;
+
+                if (size == 0)
+                    emptyTimings.add (seconds);
+            }
+
+            if (isPluginInstrument)
+            {
+                addNoteOff (mb, 1, 60, 0);
+                noise.fill (ab);
+                instance.processBlock (ab, mb);
+                mb.clear();
+            }
+
+            ut.resetTimeout();
+            logResults (ut, fixedTimings, results, emptyTimings, totalSeconds, totalSamples, bs);
+
+            ut.expectEquals (results.numNaNs, 0, "NaNs found in buffer processing variable block sizes");
+            ut.expectEquals (results.numInfs, 0, "Infs found in buffer processing variable block sizes");
+
+            ut.expectEquals (results.numSubnormals, 0, "Subnormals found in buffer processing variable block sizes");
+
+            checkAllocations (ut, numAllocations, "processing variable block sizes");
+        }
+    }
+
+    static void logResults (PluginTests& ut, const TimingStatistics& fixedTimings, const StimulusResults& results,
+                            const TimingStatistics& emptyTimings, double totalSeconds, juce::int64 totalSamples, int blockSize)
+    {
+        const auto fixedMedian = fixedTimings.getPercentile (50.0);
+
+        ut.logMessage ("Full blocks: " + fixedTimings.getDescription());
+        ut.logMessage ("Random sizes from 0 to " + juce::String (blockSize) + ": " + results.getDescription());
+
+        if (emptyTimings.getNumTimings() > 0)
+            ut.logVerboseMessage ("Empty blocks: " + emptyTimings.getDescription());
+
+        if (totalSamples > 0)
+            ut.logMessage ("Cost per sample: " + juce::String (fixedMedian * 1.0e9 / blockSize, 1) + " ns with full blocks, "
+                           + juce::String (totalSeconds * 1.0e9 / (double) totalSamples, 1) + " ns with random sizes");
+
+        // Smaller blocks should never cost much more than a full one
+        const auto worstCall = results.timing.getMax();
+
+        if (fixedMedian > 0.0 && worstCall > fixedMedian * 4.0)
+            ut.logMessage ("!!! WARNING: A call with a changed block size took " + juce::String (worstCall / fixedMedian, 1)
+                           + "x as long as a full block, the plugin may be recomputing state when the size changes");
+    }
+};
+
+static VariableBlockSizeTest variableBlockSizeTest;
+
+
+//==============================================================================
+/**
+    Hosts with worker pools call processBlock from whichever worker is free, so
+    a plugin can run on a different thread, and core, every block. This rotates
+    processBlock across a pool of threads, in turn and at random, and compares
+    the timings and allocations with processing on just one of the threads,
+    so the only difference is which thread each call is made on. Plugins
+    with thread_local caches or per-thread initialisation show up as slow first
+    calls on each thread or as calls after a migration costing more than calls
+    that stay on the same thread.
+*/
+struct ThreadMigrationTest  : public PluginTest
+{
+    ThreadMigrationTest()
+        : PluginTest ("Thread migration", 7,
+                      { Requirements::Thread::audioThread, Requirements::GUI::noGUI })
+    {
+    }
+
+    enum class Mode
+    {
+        singleThread,
+        roundRobin,
+        random
+    };
+
+    /** The timings of one way of scheduling the blocks. */
+    struct Results
+    {
+        TimingStatistics all, afterMigration, sameThread;
+        double worstFirstCallOnThread = 0.0;
+        int numAllocations = 0;
+    };
+
+    void runTest (PluginTests& ut, juce::AudioPluginInstance& instance) override
+    {
+        jassert (ut.getOptions().sampleRates.size() > 0 && ut.getOptions().blockSizes.size() > 0);
+        const double sampleRate = ut.getOptions().sampleRates[0];
+        const int blockSize = ut.getOptions().blockSizes[0];
+
+        ut.logMessage (juce::String ("Testing with sample rate [SR] and block size [BS]")
+                           .replace ("SR",juce::String (sampleRate, 0), false)
+                           .replace ("BS",juce::String (blockSize), false));
+
+        callReleaseResourcesOnMessageThreadIfVST3 (instance);
+        callPrepareToPlayOnMessageThreadIfVST3 (instance, sampleRate, blockSize);
+
+        // Pin each worker to a different core so migrating threads also migrates cores.
+        // They only use real-time scheduling if the audio processing tests do.
+        const int numCpus = juce::SystemStats::getNumCpus();
+        const int numThreads = juce::jlimit (2, 4, numCpus);
+        const int priority = ut.getOptions().realtimeThread ? ut.getOptions().realtimePriority : 0;
+        std::vector<std::unique_ptr<RealtimeThread>> pool;
+
+        for (int i = 0; i < numThreads; ++i)
+            pool.push_back (std::make_unique<RealtimeThread> (priority, i % numCpus));
+
+        ut.logMessage ("Worker pool of " + juce::String (numThreads) + " threads: " + pool.front()->getDescription());
+
+        const int numChannelsRequired = juce::jmax (instance.getTotalNumInputChannels(), instance.getTotalNumOutputChannels());
+        auto& ab = ut.getBufferPool().getAudioBuffer (numChannelsRequired, blockSize);
+        auto& mb = ut.getBufferPool().getMidiBuffer();
+
+        auto r = ut.getRandom();
+        NoiseBank noise (r);
+        const int numBlocks = getNumBenchmarkBlocks (sampleRate, blockSize);
+
+        const auto baseline = processBlocks (instance, pool, Mode::singleThread, r, noise, ab, mb, numBlocks);
+        const auto roundRobin = processBlocks (instance, pool, Mode::roundRobin, r, noise, ab, mb, numBlocks);
+        const auto random = processBlocks (instance, pool, Mode::random, r, noise, ab, mb, numBlocks);
+        pool.clear();
+
+        expectValidBuffer (ut, analyseBuffer (ab));
+        ut.resetTimeout();
+
+        const auto baselineMedian = baseline.all.getPercentile (50.0);
+        auto getRatio = [baselineMedian] (double seconds)
+        {
+            return baselineMedian > 0.0 ? ", " + juce::String (seconds / baselineMedian, 2) + "x single thread" : juce::String();
+        };
+
+        ut.logMessage ("Single thread: " + baseline.all.getDescription());
+        ut.logMessage ("Round robin: " + roundRobin.all.getDescription() + getRatio (roundRobin.all.getPercentile (50.0)));
+        ut.logMessage ("Random: " + random.all.getDescription() + getRatio (random.all.getPercentile (50.0)));
+        ut.logMessage ("First call on each thread: worst " + juce::String (roundRobin.worstFirstCallOnThread * 1.0e6, 1) + " us"
+                       + getRatio (roundRobin.worstFirstCallOnThread));
+
+        checkAllocations (ut, baseline.numAllocations, "processing on a single thread");
+        checkAllocations (ut, roundRobin.numAllocations + random.numAllocations, "processing on different threads");
+
+        if (roundRobin.numAllocations > baseline.numAllocations || random.numAllocations > baseline.numAllocations)
+            ut.logMessage ("!!! WARNING: More allocations when processing on different threads, the plugin may be setting up per-thread state");
+
+        if (baselineMedian > 0.0 && roundRobin.worstFirstCallOnThread > baselineMedian * 4.0)
+            ut.logMessage ("!!! WARNING: The first call on a new thread is " + juce::String (roundRobin.worstFirstCallOnThread / baselineMedian, 1)
+                           + "x slower, the plugin may be doing per-thread initialisation");
+
+        // Random scheduling stays on the same thread some of the time, giving a like-for-like comparison
+        if (random.afterMigration.getNumTimings() > 0 && random.sameThread.getNumTimings() > 0)
+        {
+            const auto migratedMedian = random.afterMigration.getPercentile (50.0);
+            const auto sameThreadMedian = random.sameThread.getPercentile (50.0);
+
+            ut.logMessage ("After a migration: " + juce::String (migratedMedian * 1.0e6, 1) + " us median, on the same thread: "
+                           + juce::String (sameThreadMedian * 1.0e6, 1) + " us median");
+
+            if (sameThreadMedian > 0.0 && migratedMedian > sameThreadMedian * 1.5)
+                ut.logMessage ("!!! WARNING: Calls after a migration cost " + juce::String (migratedMedian / sameThreadMedian, 2)
+                               + "x as much, the plugin may be rebuilding per-thread caches");
+        }
+    }
+
+    static Results processBlocks (juce::AudioPluginInstance& instance, std::vector<std::unique_ptr<RealtimeThread>>& pool,
+                                  Mode mode, juce::Random& r, NoiseBank& noise,
+                                  juce::AudioBuffer<float>& ab, juce::MidiBuffer& mb, int numBlocks)
+    {
+        Results results;
+        results.all.reserve (numBlocks);
+        results.afterMigration.reserve (numBlocks);
+        results.sameThread.reserve (numBlocks);
+
+        const int numThreads = (int) pool.size();
+        int previousThread = -1;
+
+        // The single thread baseline runs first, on the first worker, so only the others start out fresh
+        std::vector<bool> threadsUsed ((size_t) numThreads);
+        threadsUsed[0] = true;
+
+        // Only warm up the baseline, so first calls on the other workers are still measured
+        const int numWarmUpBlocks = mode == Mode::singleThread ? juce::jmax (2, numBlocks / 8) : 0;
+        int numWarmUpAllocations = 0;
+
+        for (int i = 0; i < numWarmUpBlocks + numBlocks; ++i)
+        {
+            const int threadIndex = mode == Mode::roundRobin ? i % numThreads
+                                  : mode == Mode::random     ? r.nextInt (numThreads)
+                                                             : 0;
+            double seconds = 0.0;
+
+            // The other modes don't warm up, so leave warm up allocations out of the comparison
+            auto& numAllocations = i < numWarmUpBlocks ? numWarmUpAllocations : results.numAllocations;
+
+            auto process = [&]
+            {
+                noise.fill (ab);
+                seconds = timeProcessBlockWithoutAllocating (instance, ab, mb, numAllocations);
+                mb.clear();
+            };
+
+            pool[(size_t) threadIndex]->call (process);
+
+            if (i < numWarmUpBlocks)
+            {
+                previousThread = threadIndex;
+                continue;
+            }
+
+            if (! threadsUsed[(size_t) threadIndex])
+            {
+                threadsUsed[(size_t) threadIndex] = true;
+                results.worstFirstCallOnThread = std::max (results.worstFirstCallOnThread, seconds);
+            }
+            else
+            {
+                results.all.add (seconds);
+
+                if (threadIndex == previousThread)
+                    results.sameThread.add (seconds);
+                else
+                    results.afterMigration.add (seconds);
+            }
+
+            previousThread = threadIndex;
+        }
+
+        return results;
+    }
+};
+
+static ThreadMigrationTest threadMigrationTest;
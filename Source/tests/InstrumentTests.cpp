@@ -0,0 +1,548 @@
+/*==============================================================================
+
+  Copyright 2018 by Tracktion Corporation.
+  For more information visit www.tracktion.com
+
+   You may also use this code under the terms of the GPL v3 (see
+   www.gnu.org/licenses).
+
+   pluginval IS PROVIDED "AS IS" WITHOUT ANY WARRANTY, AND ALL WARRANTIES, WHETHER
+   EXPRESSED OR IMPLIED, INCLUDING MERCHANTABILITY AND FITNESS FOR PURPOSE, ARE
+   DISCLAIMED.
+
+ ==============================================================================*/
+
+#include "../PluginTests.h"
+#include "../TestUtilities.h"
+#include <bitset>
+
+namespace
+{
+    /** Fills a MidiBuffer with a mix of the events a busy MPE controller and
+        sequencer would send, spread evenly over the block.
+        Every note-on is paired with a note-off so notes don't pile up.
+    */
+    void createDenseMidi (juce::MidiBuffer& mb, juce::Random& r, int numEvents, int blockSize)
+    {
+        mb.clear();
+
+        if (numEvents <= 0)
+            return;
+
+        // One large SysEx dump per block, e.g. a patch or sample transfer
+        {
+            std::vector<juce::uint8> sysEx (1024);
+            sysEx.front() = 0xf0;
+            sysEx.back() = 0xf7;
+
+            for (size_t i = 1; i < sysEx.size() - 1; ++i)
+                sysEx[i] = (juce::uint8) r.nextInt (128);
+
+            mb.addEvent (sysEx.data(), (int) sysEx.size(), 0);
+        }
+
+        int noteNumber = 60;
+
+        for (int i = 1; i < numEvents; ++i)
+        {
+            const int sample = (int) ((juce::int64) i * blockSize / numEvents);
+            const int memberChannel = 2 + (i % 15);
+
+            switch (i % 8)
+            {
+                case 0:     noteNumber = 36 + r.nextInt (60);
+                            mb.addEvent (juce::MidiMessage::noteOn (memberChannel, noteNumber, r.nextFloat()), sample); break;
+                case 1:     mb.addEvent (juce::MidiMessage::noteOff (2 + ((i - 1) % 15), noteNumber), sample); break;
+                case 2:     mb.addEvent (juce::MidiMessage::controllerEvent (1, 1, r.nextInt (128)), sample); break;
+                case 3:     mb.addEvent (juce::MidiMessage::controllerEvent (1, 11, r.nextInt (128)), sample); break;
+                case 4:     mb.addEvent (juce::MidiMessage::pitchWheel (1, r.nextInt (16384)), sample); break;
+                case 5:     mb.addEvent (juce::MidiMessage::pitchWheel (memberChannel, r.nextInt (16384)), sample); break;
+                case 6:     mb.addEvent (juce::MidiMessage::channelPressureChange (memberChannel, r.nextInt (128)), sample); break;
+                case 7:     mb.addEvent (juce::MidiMessage::controllerEvent (memberChannel, 74, r.nextInt (128)), sample); break;
+                default:    break;
+            }
+        }
+    }
+
+    /** Keeps track of the notes that have been started so each one can be stopped
+        with its own note-off. Many plugins ignore all-notes-off, and VST3 has no
+        equivalent so the host wrapper usually drops it.
+    */
+    class HeldNotes
+    {
+    public:
+        /** Adds a note-on to the buffer and remembers the note. */
+        void noteOn (juce::MidiBuffer& mb, int channel, int noteNumber, int sample)
+        {
+            addNoteOn (mb, channel, noteNumber, sample);
+            notes[(size_t) channel - 1].set ((size_t) noteNumber);
+        }
+
+        /** Adds a note-off for every remembered note and forgets them. */
+        void addNoteOffs (juce::MidiBuffer& mb, int sample)
+        {
+            for (int channel = 1; channel <= 16; ++channel)
+            {
+                auto& channelNotes = notes[(size_t) channel - 1];
+
+                for (int noteNumber = 0; noteNumber < 128 && channelNotes.any(); ++noteNumber)
+                {
+                    if (channelNotes.test ((size_t) noteNumber))
+                    {
+                        addNoteOff (mb, channel, noteNumber, sample);
+                        channelNotes.reset ((size_t) noteNumber);
+                    }
+                }
+            }
+        }
+
+    private:
+        std::array<std::bitset<128>, 16> notes;
+    };
+
+    /** Releases any sounding notes and processes a second of silence so they can decay.
+        Each held note gets a note-off, then all-notes-off and all-sound-off are sent
+        as a backstop for any that weren't tracked.
+    */
+    void releaseAllNotes (juce::AudioPluginInstance& instance, juce::AudioBuffer<float>& ab, juce::MidiBuffer& mb,
+                          double sampleRate, HeldNotes& heldNotes)
+    {
+        mb.clear();
+        heldNotes.addNoteOffs (mb, 0);
+
+        for (int channel = 1; channel <= 16; ++channel)
+        {
+            mb.addEvent (juce::MidiMessage::allNotesOff (channel), 0);
+            mb.addEvent (juce::MidiMessage::allSoundOff (channel), 0);
+        }
+
+        for (auto numSamples = (juce::int64) sampleRate; numSamples > 0; numSamples -= ab.getNumSamples())
+        {
+            ab.clear();
+            instance.processBlock (ab, mb);
+            mb.clear();
+        }
+    }
+
+    /** Returns the index of the first sample on any channel whose magnitude is
+        above the threshold, or -1 if the buffer is quieter than that.
+    */
+    int findFirstSampleAbove (const juce::AudioBuffer<float>& ab, float threshold)
+    {
+        int firstIndex = -1;
+
+        for (int ch = 0; ch < ab.getNumChannels(); ++ch)
+        {
+            const auto* samples = ab.getReadPointer (ch);
+            const int numToSearch = firstIndex < 0 ? ab.getNumSamples() : firstIndex;
+
+            for (int i = 0; i < numToSearch; ++i)
+            {
+                if (std::abs (samples[i]) > threshold)
+                {
+                    firstIndex = i;
+                    break;
+                }
+            }
+        }
+
+        return firstIndex;
+    }
+}
+
+
+//==============================================================================
+/**
+    Sends increasingly dense MIDI to plugins that accept it, from no events up
+    to thousands per block, including CC streams, pitch bend, MPE
+    per-note expression and large SysEx messages. Reports the cost per event
+    and the density at which processing can no longer keep up with real-time.
+*/
+struct DenseMidiTest    : public PluginTest
+{
+    DenseMidiTest()
+        : PluginTest ("Dense MIDI", 8,
+                      { Requirements::Thread::audioThread, Requirements::GUI::noGUI })
+    {
+    }
+
+    void runTest (PluginTests& ut, juce::AudioPluginInstance& instance) override
+    {
+        if (! instance.acceptsMidi())
+        {
+            ut.logMessage ("INFO: Skipping test as plugin doesn't accept MIDI");
+            return;
+        }
+
+        const std::vector<double>& sampleRates = ut.getOptions().sampleRates;
+        const std::vector<int>& blockSizes = ut.getOptions().blockSizes;
+
+        jassert (sampleRates.size() > 0 && blockSizes.size() > 0);
+        const double sampleRate = sampleRates[0];
+        const int blockSize = blockSizes[0];
+        const double blockDuration = blockSize / sampleRate;
+
+        ut.logMessage (juce::String ("Testing with sample rate [SR] and block size [BS]")
+                           .replace ("SR",juce::String (sampleRate, 0), false)
+                           .replace ("BS",juce::String (blockSize), false));
+
+        callReleaseResourcesOnMessageThreadIfVST3 (instance);
+        callPrepareToPlayOnMessageThreadIfVST3 (instance, sampleRate, blockSize);
+
+        auto r = ut.getRandom();
+        NoiseBank noise (r);
+
+        const int numChannelsRequired = juce::jmax (instance.getTotalNumInputChannels(), instance.getTotalNumOutputChannels());
+        auto& ab = ut.getBufferPool().getAudioBuffer (numChannelsRequired, blockSize);
+
+        // Put the plugin in MPE mode with all member channels in the lower zone
+        {
+            auto mpeSetup = juce::MPEMessages::setLowerZone (15);
+            noise.fill (ab);
+            instance.processBlock (ab, mpeSetup);
+        }
+
+        const int numBlocks = 64, numWarmUpBlocks = 4;
+        double baselineMedian = 0.0;
+        bool keptUpWithRealtime = true;
+
+        for (int numEvents : { 0, 16, 64, 256, 1024, 4096 })
+        {
+            // Build the events up front and leave the pool's MIDI buffer room for them
+            // and for any the plugin outputs, so only the plugin's own allocations are caught
+            juce::MidiBuffer events;
+            createDenseMidi (events, r, numEvents, blockSize);
+            ut.getBufferPool().reserve (0, 0, (int) events.data.size() * 2);
+            auto& mb = ut.getBufferPool().getMidiBuffer();
+
+            TimingStatistics timings;
+            timings.reserve (numBlocks);
+            int numAllocations = 0;
+
+            for (int i = 0; i < numWarmUpBlocks + numBlocks; ++i)
+            {
+                mb.clear();
+                mb.addEvents (events, 0, -1, 0);
+                noise.fill (ab);
+
+                const auto seconds = timeProcessBlockWithoutAllocating (instance, ab, mb, numAllocations);
+
+                if (i >= numWarmUpBlocks)
+                    timings.add (seconds);
+            }
+
+            mb.clear();
+            expectValidBuffer (ut, analyseBuffer (ab));
+
+            const auto median = timings.getPercentile (50.0);
+            juce::String description (juce::String (numEvents) + " events per block: " + juce::String (median * 1.0e6, 1)
+                                      + " us, " + juce::String (median * 100.0 / blockDuration, 1) + "% of real-time");
+
+            if (numEvents == 0)
+                baselineMedian = median;
+            else
+                description << ", " << juce::String ((median - baselineMedian) * 1.0e9 / numEvents, 1) << " ns per event";
+
+            ut.logMessage (description);
+            ut.logVerboseMessage (timings.getDescription());
+
+            checkAllocations (ut, numAllocations, "processing " + juce::String (numEvents) + " MIDI events per block");
+            ut.resetTimeout();
+
+            if (median > blockDuration)
+            {
+                ut.logMessage ("Misses real-time at " + juce::String (numEvents) + " events per block");
+                keptUpWithRealtime = false;
+                break;
+            }
+        }
+
+        if (keptUpWithRealtime)
+            ut.logMessage ("Keeps up with real-time at all tested MIDI densities");
+
+        // Take the plugin back out of MPE mode so later tests aren't affected
+        {
+            auto mpeReset = juce::MPEMessages::clearAllZones();
+            ab.clear();
+            instance.processBlock (ab, mpeReset);
+        }
+    }
+};
+
+static DenseMidiTest denseMidiTest;
+
+
+//==============================================================================
+/**
+    Measures how an instrument's cost grows as the number of held notes ramps
+    from 1 to 128, producing a CPU-vs-voices curve. Then keeps triggering new
+    notes beyond the voice limit to force voice stealing, checking for CPU
+    spikes and allocations whilst voices are stolen.
+*/
+struct PolyphonyScalingTest : public PluginTest
+{
+    PolyphonyScalingTest()
+        : PluginTest ("Polyphony scaling", 8,
+                      { Requirements::Thread::audioThread, Requirements::GUI::noGUI })
+    {
+    }
+
+    void runTest (PluginTests& ut, juce::AudioPluginInstance& instance) override
+    {
+        if (! instance.getPluginDescription().isInstrument)
+        {
+            ut.logMessage ("INFO: Skipping test as plugin isn't an instrument");
+            return;
+        }
+
+        const std::vector<double>& sampleRates = ut.getOptions().sampleRates;
+        const std::vector<int>& blockSizes = ut.getOptions().blockSizes;
+
+        jassert (sampleRates.size() > 0 && blockSizes.size() > 0);
+        const double sampleRate = sampleRates[0];
+        const int blockSize = blockSizes[0];
+        const double blockDuration = blockSize / sampleRate;
+
+        ut.logMessage (juce::String ("Testing with sample rate [SR] and block size [BS]")
+                           .replace ("SR",juce::String (sampleRate, 0), false)
+                           .replace ("BS",juce::String (blockSize), false));
+
+        callReleaseResourcesOnMessageThreadIfVST3 (instance);
+        callPrepareToPlayOnMessageThreadIfVST3 (instance, sampleRate, blockSize);
+
+        const int numChannelsRequired = juce::jmax (instance.getTotalNumInputChannels(), instance.getTotalNumOutputChannels());
+        auto& ab = ut.getBufferPool().getAudioBuffer (numChannelsRequired, blockSize);
+        auto& mb = ut.getBufferPool().getMidiBuffer();
+
+        const int numBlocks = 32, numWarmUpBlocks = 4;
+        int numAllocations = 0;
+        double baselineMedian = 0.0, fullPolyphonyMedian = 0.0;
+        HeldNotes heldNotes;
+
+        ut.logMessage ("Voices, median time, % of real-time, time per voice");
+
+        for (int numVoices : { 0, 1, 2, 4, 8, 16, 32, 64, 128 })
+        {
+            releaseAllNotes (instance, ab, mb, sampleRate, heldNotes);
+
+            for (int i = 0; i < numVoices; ++i)
+                heldNotes.noteOn (mb, 1, getNoteNumber (i), 0);
+
+            TimingStatistics timings;
+            timings.reserve (numBlocks);
+
+            for (int i = 0; i < numWarmUpBlocks + numBlocks; ++i)
+            {
+                ab.clear();
+                const auto seconds = timeProcessBlockWithoutAllocating (instance, ab, mb, numAllocations);
+                mb.clear();
+
+                if (i >= numWarmUpBlocks)
+                    timings.add (seconds);
+            }
+
+            expectValidBuffer (ut, analyseBuffer (ab));
+
+            const auto median = timings.getPercentile (50.0);
+            juce::String row;
+            row << numVoices << ", " << juce::String (median * 1.0e6, 1) << " us, "
+                << juce::String (median * 100.0 / blockDuration, 1) << "%";
+
+            if (numVoices == 0)
+                baselineMedian = median;
+            else
+                row << ", " << juce::String ((median - baselineMedian) * 1.0e6 / numVoices, 2) << " us";
+
+            ut.logMessage (row);
+            fullPolyphonyMedian = median;
+            ut.resetTimeout();
+        }
+
+        checkAllocations (ut, numAllocations, "playing notes");
+        numAllocations = 0;
+
+        // With all 128 notes still held, keep adding notes on other channels so the
+        // plugin has to steal voices every block
+        TimingStatistics stealTimings;
+        stealTimings.reserve (numBlocks);
+
+        for (int i = 0; i < numBlocks; ++i)
+        {
+            for (int n = 0; n < 16; ++n)
+                heldNotes.noteOn (mb, 2 + (i % 15), getNoteNumber (i * 16 + n), n * blockSize / 16);
+
+            ab.clear();
+            stealTimings.add (timeProcessBlockWithoutAllocating (instance, ab, mb, numAllocations));
+            mb.clear();
+        }
+
+        releaseAllNotes (instance, ab, mb, sampleRate, heldNotes);
+        expectValidBuffer (ut, analyseBuffer (ab));
+
+        ut.logMessage ("Voice stealing: " + stealTimings.getDescription());
+        checkAllocations (ut, numAllocations, "stealing voices");
+
+        const auto worstSteal = stealTimings.getMax();
+
+        if (worstSteal > blockDuration)
+            ut.logMessage ("!!! WARNING: Stealing voices took " + juce::String (worstSteal * 100.0 / blockDuration, 1)
+                           + "% of the real-time budget for a block");
+        else if (fullPolyphonyMedian > 0.0 && worstSteal > fullPolyphonyMedian * 4.0)
+            ut.logMessage ("!!! WARNING: Stealing voices caused a spike of " + juce::String (worstSteal / fullPolyphonyMedian, 1)
+                           + "x the cost of sustaining 128 notes");
+    }
+
+    /** Spreads notes out either side of middle C so any number up to 128 are all different. */
+    static int getNoteNumber (int index)
+    {
+        index %= 128;
+        return (index % 2 == 0) ? 64 + index / 2 : 63 - index / 2;
+    }
+};
+
+static PolyphonyScalingTest polyphonyScalingTest;
+
+
+//==============================================================================
+/**
+    Places note-ons at different offsets within a block at each block size and
+    measures how long it takes for the output to become non-silent, beyond the
+    latency the plugin reports. Instruments that only start notes at block
+    boundaries, or trigger late, feel sluggish when played live.
+*/
+struct NoteOnLatencyTest    : public PluginTest
+{
+    NoteOnLatencyTest()
+        : PluginTest ("Note-on latency", 7,
+                      { Requirements::Thread::audioThread, Requirements::GUI::noGUI })
+    {
+    }
+
+    void runTest (PluginTests& ut, juce::AudioPluginInstance& instance) override
+    {
+        if (! instance.getPluginDescription().isInstrument)
+        {
+            ut.logMessage ("INFO: Skipping test as plugin isn't an instrument");
+            return;
+        }
+
+        const std::vector<double>& sampleRates = ut.getOptions().sampleRates;
+        const std::vector<int>& blockSizes = ut.getOptions().blockSizes;
+
+        jassert (sampleRates.size() > 0 && blockSizes.size() > 0);
+        const double sampleRate = sampleRates[0];
+        const float threshold = juce::Decibels::decibelsToGain (-80.0f);
+
+        int worstLatency = 0;
+        bool anyMeasured = false;
+
+        ut.logMessage ("Block size, note-on offsets, reported latency, min trigger latency, max trigger latency (samples)");
+
+        for (auto bs : blockSizes)
+        {
+            callReleaseResourcesOnMessageThreadIfVST3 (instance);
+            callPrepareToPlayOnMessageThreadIfVST3 (instance, sampleRate, bs);
+
+            const int numChannelsRequired = juce::jmax (instance.getTotalNumInputChannels(), instance.getTotalNumOutputChannels());
+            auto& ab = ut.getBufferPool().getAudioBuffer (numChannelsRequired, bs);
+            auto& mb = ut.getBufferPool().getMidiBuffer();
+
+            const int reportedLatency = instance.getLatencySamples();
+            const int maxBlocksToWait = juce::jmax (2, (int) (sampleRate * 0.5) / bs + reportedLatency / bs + 1);
+
+            juce::SortedSet<int> offsets;
+
+            for (auto offset : { 0, 1, bs / 3, bs / 2, bs - 1 })
+                if (juce::isPositiveAndBelow (offset, bs))
+                    offsets.add (offset);
+
+            int minLatency = std::numeric_limits<int>::max(), maxLatency = std::numeric_limits<int>::min();
+            int numMeasured = 0, numOnBlockBoundaries = 0, numOffsetsAfterStart = 0;
+            HeldNotes heldNotes;
+
+            for (auto offset : offsets)
+            {
+                releaseAllNotes (instance, ab, mb, sampleRate, heldNotes);
+
+                // Make sure the plugin has gone quiet before triggering the note
+                ab.clear();
+                instance.processBlock (ab, mb);
+
+                if (findFirstSampleAbove (ab, threshold) >= 0)
+                {
+                    ut.logMessage ("INFO: Plugin isn't silent after releasing all notes, skipping block size " + juce::String (bs));
+                    break;
+                }
+
+                heldNotes.noteOn (mb, 1, 60, offset);
+                int soundPosition = -1;
+
+                for (int block = 0; block < maxBlocksToWait && soundPosition < 0; ++block)
+                {
+                    ab.clear();
+                    instance.processBlock (ab, mb);
+                    mb.clear();
+
+                    if (const int index = findFirstSampleAbove (ab, threshold); index >= 0)
+                        soundPosition = block * bs + index;
+                }
+
+                expectValidBuffer (ut, analyseBuffer (ab));
+
+                // Stop the note straight away so the next offset starts from silence
+                heldNotes.addNoteOffs (mb, 0);
+                ab.clear();
+                instance.processBlock (ab, mb);
+                mb.clear();
+
+                if (soundPosition < 0)
+                {
+                    ut.logMessage ("INFO: No output within 500 ms of a note-on at sample " + juce::String (offset));
+                    continue;
+                }
+
+                const int compensatedPosition = soundPosition - reportedLatency;
+                const int latency = compensatedPosition - offset;
+                minLatency = juce::jmin (minLatency, latency);
+                maxLatency = juce::jmax (maxLatency, latency);
+                ++numMeasured;
+
+                ut.logVerboseMessage ("Note-on at sample " + juce::String (offset) + " sounded at sample " + juce::String (soundPosition));
+
+                if (offset > 0)
+                {
+                    ++numOffsetsAfterStart;
+
+                    if (compensatedPosition > offset && compensatedPosition % bs == 0)
+                        ++numOnBlockBoundaries;
+                }
+            }
+
+            ut.resetTimeout();
+
+            if (numMeasured == 0)
+                continue;
+
+            anyMeasured = true;
+            worstLatency = juce::jmax (worstLatency, maxLatency);
+
+            ut.logMessage (juce::String (bs) + ", " + juce::String (offsets.size()) + ", " + juce::String (reportedLatency) + ", "
+                           + juce::String (minLatency) + ", " + juce::String (maxLatency));
+
+            if (numOffsetsAfterStart > 0 && numOnBlockBoundaries == numOffsetsAfterStart)
+                ut.logMessage ("!!! WARNING: Notes only start on block boundaries at block size " + juce::String (bs)
+                               + ", so trigger timing depends on the host's buffer size");
+        }
+
+        if (! anyMeasured)
+        {
+            ut.logMessage ("INFO: Unable to measure note-on latency as no output was produced");
+            return;
+        }
+
+        ut.logMessage ("Worst trigger latency beyond the reported latency: " + juce::String (worstLatency) + " samples ("
+                       + juce::String (worstLatency * 1000.0 / sampleRate, 2) + " ms)");
+    }
+};
+
+static NoteOnLatencyTest noteOnLatencyTest;